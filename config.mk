@@ -1,3 +1,8 @@
-OFFSET := 0x123E600
+# Where the code goes in the ROM. "auto" picks the first run of free bytes after
+# FREESPACE_START that fits it; set an address to pin it there instead.
+OFFSET := auto
+FREESPACE_START := 0x1000000
+FREESPACE_ALIGN := 4
+FREESPACE_FILL := 0xFF
 ROM_NAME := BPRE0.gba
 OUTPUT_NAME := test.gba
\ No newline at end of file
@@ -0,0 +1,128 @@
+#!/usr/bin/env python3
+
+import os
+import re
+import sys
+import struct
+import argparse
+
+if sys.version_info < (3, 4):
+        print('Python 3.4 or later is required.')
+        sys.exit(1)
+
+# Parse arguments
+parser = argparse.ArgumentParser(description='Precompute the crack strips minigame.c copies into the excavation tilemap.')
+parser.add_argument('--frames', metavar='file',
+                    help='crack frames, as tiles of the sheet', default='graphics/excavation/cracks.txt')
+parser.add_argument('--png', metavar='file',
+                    help='tile sheet the frames are drawn from', default='graphics/excavation/cracks_terrain.png')
+parser.add_argument('--tilemap', metavar='file',
+                    help='tilemap the crack is drawn over', default='graphics/excavation/cracks_terrain.bin')
+parser.add_argument('--output', metavar='file',
+                    help='header to write the strips to', default='src/crack_strips.h')
+args = parser.parse_args()
+
+# The BG palette cracks_terrain.gbapal is loaded into
+PALETTE = 1
+TILEMAP_WIDTH = 32
+
+def read_frames(path):
+        segments = None
+        frames = []
+        with open(path, 'r') as file:
+                for number, line in enumerate(file, 1):
+                        line = line.split('#', 1)[0].split()
+                        if not line:
+                                continue
+                        if line[0] == 'segments' and len(line) == 4:
+                                segments = [int(value, 0) for value in line[1:]]
+                        elif line[0] == 'frame' and len(line) == 2 and int(line[1], 0) == len(frames):
+                                frames.append([])
+                        elif len(line) == 3 and frames:
+                                frames[-1].append([int(value, 0) for value in line])
+                        else:
+                                raise SystemExit('{}:{}: expected "segments left stride count", "frame n" or "column row tile"'.format(path, number))
+
+        if segments is None or len(frames) < 2:
+                raise SystemExit('{}: needs a segments line and at least two frames'.format(path))
+        return segments, frames
+
+def count_tiles(path):
+        with open(path, 'rb') as file:
+                header = file.read(24)
+        if header[:8] != b'\x89PNG\r\n\x1a\n' or header[12:16] != b'IHDR':
+                raise SystemExit('{}: not a png'.format(path))
+        width, height = struct.unpack('>II', header[16:24])
+        return (width // 8) * (height // 8)
+
+def read_tilemap(path, rows):
+        with open(path, 'rb') as file:
+                data = file.read(TILEMAP_WIDTH * rows * 2)
+        entries = struct.unpack('<{}H'.format(TILEMAP_WIDTH * rows), data)
+        return [list(entries[row * TILEMAP_WIDTH:(row + 1) * TILEMAP_WIDTH]) for row in range(rows)]
+
+def build_strips(segments, frames, num_tiles, bar):
+        first, stride, count = segments
+        width = max(column for frame in frames for column, row, tile in frame) + 1
+        height = len(bar)
+        strips = []
+
+        for segment in range(count):
+                left = first - segment * stride
+                row_strips = []
+                for index, frame in enumerate(frames):
+                        if segment > 0 and index == 0:
+                                row_strips.append(None)
+                                continue
+                        for column, row, tile in frame:
+                                if tile >= num_tiles:
+                                        raise SystemExit('{}: frame {} uses tile {}, but {} has {} tiles'.format(args.frames, index, hex(tile), args.png, num_tiles))
+                                # The last segment starts three columns left of the screen. The routines this
+                                # replaced took those columns as u8 (253-255) and so wrote the tiles into BG2
+                                # rows 7-10, columns 29-31, down in the wall's rows. They're dropped instead.
+                                if 0 <= left + column < TILEMAP_WIDTH:
+                                        bar[row][left + column] = tile | (PALETTE << 12)
+                        # The whole segment as it stands now, which also settles whatever a skipped frame left
+                        start = max(left, 0)
+                        end = min(left + width, TILEMAP_WIDTH)
+                        row_strips.append((start, [bar[row][start:end] for row in range(height)]))
+                strips.append(row_strips)
+
+        return width, height, strips
+
+def write_strips(path, width, height, frames, strips):
+        lines = ['// Generated by scripts/crack_strips.py from {}. Do not edit.'.format(args.frames),
+                 '',
+                 '#define CRACK_STRIP_WIDTH {}'.format(width),
+                 '#define CRACK_STRIP_HEIGHT {}'.format(height),
+                 '#define CRACK_FRAME_COUNT {}'.format(frames),
+                 '',
+                 '// The top rows of BG2 from column left on, as they stand after one frame of one segment of the crack',
+                 'struct CrackStrip',
+                 '{',
+                 '    u8 left;',
+                 '    u8 width;',
+                 '    u16 tiles[CRACK_STRIP_HEIGHT][CRACK_STRIP_WIDTH];',
+                 '};',
+                 '',
+                 'static const struct CrackStrip sCrackStrips[{}][CRACK_FRAME_COUNT] = {{'.format(len(strips))]
+        for segment in strips:
+                lines.append('    {')
+                for strip in segment:
+                        if strip is None:
+                                lines.append('        {0},')
+                                continue
+                        left, rows = strip
+                        lines.append('        {{{}, {}, {{{}}}}},'.format(left, len(rows[0]), ', '.join(
+                                '{' + ', '.join('0x{:04X}'.format(entry) for entry in row) + '}' for row in rows)))
+                lines.append('    },')
+        lines.append('};')
+
+        os.makedirs(os.path.dirname(path) or '.', exist_ok=True)
+        with open(path, 'w') as file:
+                file.write('\n'.join(lines) + '\n')
+
+segments, frames = read_frames(args.frames)
+height = max(row for frame in frames for column, row, tile in frame) + 1
+width, height, strips = build_strips(segments, frames, count_tiles(args.png), read_tilemap(args.tilemap, height))
+write_strips(args.output, width, height, len(frames), strips)
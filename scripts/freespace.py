@@ -0,0 +1,121 @@
+#!/usr/bin/env python3
+
+import os
+import re
+import sys
+import json
+import mmap
+import argparse
+
+if sys.version_info < (3, 4):
+        print('Python 3.4 or later is required.')
+        sys.exit(1)
+
+# Parse arguments
+parser = argparse.ArgumentParser(description='Find free space in the base ROM for the linked code.')
+parser.add_argument('--rom', metavar='file',
+                    help='base ROM to search', default='BPRE0.gba')
+parser.add_argument('--fit', metavar='file',
+                    help='allocate room for this file and print its offset', required=True)
+parser.add_argument('--check', metavar='offset',
+                    help='only check that the file fits at this offset')
+parser.add_argument('--start', metavar='offset',
+                    help='lowest offset to allocate at', default='0x800000')
+parser.add_argument('--align', metavar='bytes',
+                    help='alignment of the allocation', default='4')
+parser.add_argument('--fill', metavar='byte',
+                    help='value of free bytes', default='0xFF')
+parser.add_argument('--min-run', metavar='bytes',
+                    help='shortest run of free bytes worth indexing', default='0x100')
+parser.add_argument('--index', metavar='file',
+                    help='cached free space index', default='build/freespace.json')
+args = parser.parse_args()
+
+# Biggest ROM the GBA maps. Whatever lies past the end of the base ROM is free.
+MAX_ROM_SIZE = 0x2000000
+
+def scan(rom, fill, min_run):
+        # Both searches run in C over the whole mapping: find() jumps to the
+        # next run long enough to index, and the regex to the byte ending it.
+        # A run always starts where find() lands, since the search resumes
+        # just past a used byte.
+        block = bytes([fill]) * min_run
+        used = re.compile(b'[^' + re.escape(bytes([fill])) + b']')
+        runs = []
+
+        start = rom.find(block)
+        while start != -1:
+                match = used.search(rom, start + min_run)
+                end = match.start() if match else len(rom)
+                runs.append([start, end])
+                start = rom.find(block, end)
+
+        # The ROM can grow into the rest of the address space, so a run that
+        # reaches the end of the file goes on to the end of it.
+        if runs and runs[-1][1] == len(rom):
+                runs[-1][1] = MAX_ROM_SIZE
+        elif len(rom) < MAX_ROM_SIZE:
+                runs.append([len(rom), MAX_ROM_SIZE])
+
+        return runs
+
+def load_index(path, fill, min_run):
+        info = os.stat(path)
+        key = {'rom': path, 'stamp': [info.st_size, info.st_mtime_ns], 'fill': fill, 'min_run': min_run, 'max_size': MAX_ROM_SIZE}
+
+        try:
+                with open(args.index, 'r') as index:
+                        record = json.load(index)
+                if record.get('key') == key:
+                        return record['runs']
+        except (OSError, ValueError):
+                pass
+
+        with open(path, 'rb') as file, mmap.mmap(file.fileno(), 0, access=mmap.ACCESS_READ) as rom:
+                runs = scan(rom, fill, min_run)
+
+        os.makedirs(os.path.dirname(args.index) or '.', exist_ok=True)
+        with open(args.index, 'w') as index:
+                json.dump({'key': key, 'runs': runs}, index)
+
+        return runs
+
+class FreeSpace:
+        def __init__(self, runs):
+                self.runs = [list(run) for run in runs]
+
+        def allocate(self, size, align=4, start=0):
+                # First fit, so the allocation only moves when what's being
+                # placed outgrows its run.
+                for i, (run_start, run_end) in enumerate(self.runs):
+                        # Keep the first free byte: it may be the 0xFF that
+                        # terminates a string or table right before the run.
+                        begin = max(run_start + 1, start)
+                        begin = (begin + align - 1) // align * align
+
+                        if begin + size <= run_end:
+                                self.runs[i:i + 1] = [r for r in ([run_start, begin], [begin + size, run_end]) if r[0] < r[1]]
+                                return begin
+
+                return None
+
+        def contains(self, begin, end):
+                return any(run_start <= begin and end <= run_end for run_start, run_end in self.runs)
+
+runs = load_index(args.rom, int(args.fill, 0), int(args.min_run, 0))
+space = FreeSpace(runs)
+size = os.path.getsize(args.fit)
+
+if args.check is not None:
+        offset = int(args.check, 0)
+        if not space.contains(offset, offset + size):
+                print('{} ({} bytes) no longer fits at {}.'.format(args.fit, size, hex(offset)), file=sys.stderr)
+                sys.exit(1)
+        sys.exit(0)
+
+offset = space.allocate(size, int(args.align, 0), int(args.start, 0))
+if offset is None:
+        print('No free space in {} for {} ({} bytes).'.format(args.rom, args.fit, size), file=sys.stderr)
+        sys.exit(1)
+
+print(hex(offset).upper().replace('X', 'x'))
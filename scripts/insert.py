@@ -9,6 +9,10 @@ import textwrap
 import sys
 import argparse
 import _io
+import json
+import mmap
+import struct
+import zlib
 
 if sys.version_info < (3, 4):
         print('Python 3.4 or later is required.')
@@ -22,42 +26,87 @@ parser.add_argument('--input', metavar='file',
                     help='input filename', default='BPRE0.gba')
 parser.add_argument('--output', metavar='file', 
                     help='output filename', default='test.gba')
+parser.add_argument('--incremental', action='store_true',
+                    help='patch the previous output in place instead of copying the input')
+parser.add_argument('--journal', metavar='file',
+                    help='record of the ranges written to the output', default='build/insert.journal')
+parser.add_argument('--elf', metavar='file',
+                    help='linked code to take symbols from', default='build/linker.o')
+parser.add_argument('--symbols', metavar='file',
+                    help='also write the symbol table here, like objdump -t')
+parser.add_argument('--bps', metavar='file',
+                    help='also write a BPS patch from the input to the output')
+parser.add_argument('--ips', metavar='file',
+                    help='also write an IPS patch (only reaches the first 16MB)')
 args = parser.parse_args()
 
-def get_text_section():
-        # Dump sections
-        with open("build/rom.sym", "r") as symfile:
-            lines = symfile.readlines()
-        
-        # Find text section
-        text = filter(lambda x: x.strip().endswith('.text'), lines)
-        section = list(text)[0]
-        
-        # Get the offset
-        offset = int(section.split(' ')[0], 16)
-        
-        return offset
+class ElfFile:
+        # Just enough of an ELF32 little-endian reader for the linked code:
+        # the section headers and the symbol table, read in one pass.
+        SHT_SYMTAB = 2
+        STT_FUNC = 2
+        STT_SECTION = 3
+        STT_FILE = 4
+        STT_GNU_IFUNC = 10
+        EM_ARM = 40
 
-def symbols(subtract=0):
-        with open("build/rom_1.sym", "r") as symfile:
-            lines = symfile.readlines()
-        
-        name = ''
-        
-        ret = {}
-        for line in lines:
-                parts = line.strip().split()
-                
-                if (len(parts) < 3):
-                        continue
-                        
-                if (parts[1].lower() != 't'):
-                        continue
-                        
-                offset = int(parts[0], 16)
-                ret[parts[2]] = offset - subtract
-                
-        return ret
+        def __init__(self, path):
+                with open(path, 'rb') as file:
+                        data = file.read()
+
+                if data[:4] != b'\x7fELF' or data[4] != 1 or data[5] != 1:
+                        raise ValueError(path + ' is not a 32-bit little-endian ELF file.')
+
+                machine, = struct.unpack_from('<H', data, 0x12)
+                self.path = path
+                self.format = 'elf32-littlearm' if machine == self.EM_ARM else 'elf32-little'
+
+                shoff, = struct.unpack_from('<I', data, 0x20)
+                shentsize, shnum, shstrndx = struct.unpack_from('<HHH', data, 0x2E)
+                headers = [struct.unpack_from('<10I', data, shoff + i * shentsize) for i in range(shnum)]
+                names = headers[shstrndx][4]
+
+                self.sections = {}
+                self.symbols = []
+                for index, (name, kind, flags, addr, offset, size, link, info, align, entsize) in enumerate(headers):
+                        self.sections[self.c_string(data, names + name)] = (index, addr, size)
+
+                        if kind == self.SHT_SYMTAB:
+                                strings = headers[link][4]
+                                for sym_name, value, sym_size, sym_info, other, shndx in struct.iter_unpack('<IIIBBH', data[offset:offset + size]):
+                                        # Thumb functions have bit 0 of their address set. Drop it the way
+                                        # BFD does (elf32_arm_swap_symbol_in), so addresses match nm and objdump.
+                                        if machine == self.EM_ARM and (sym_info & 0xF) in (self.STT_FUNC, self.STT_GNU_IFUNC):
+                                                value &= ~1
+                                        self.symbols.append((self.c_string(data, strings + sym_name), value, sym_size, sym_info, shndx))
+
+        @staticmethod
+        def c_string(data, offset):
+                return data[offset:data.index(b'\0', offset)].decode('ascii', 'replace')
+
+        def section_symbols(self, section):
+                # Name -> address of the code and data labels in one section,
+                # like the t/T lines of nm.
+                index = self.sections[section][0]
+                return {name: value for name, value, size, info, shndx in self.symbols
+                        if shndx == index and name and (info & 0xF) not in (self.STT_SECTION, self.STT_FILE)}
+
+        def write_symbols(self, path):
+                # Same layout as objdump -t, for debuggers that read test.sym.
+                section_names = {index: name for name, (index, addr, size) in self.sections.items()}
+                special = {0: '*UND*', 0xFFF1: '*ABS*', 0xFFF2: '*COM*'}
+                kinds = {1: ' O', 2: ' F', 3: 'd ', 4: 'df'}
+                with open(path, 'w') as file:
+                        file.write('\n{}:     file format {}\n\nSYMBOL TABLE:\n'.format(self.path, self.format))
+                        for name, value, size, info, shndx in self.symbols[1:]:
+                                bind = info >> 4
+                                flags = ('l' if bind == 0 else 'g' if bind == 1 else ' ') + ('w' if bind == 2 else ' ')
+                                flags += '   ' + kinds.get(info & 0xF, '  ')
+                                section = special.get(shndx, section_names.get(shndx, '*UND*'))
+                                if (info & 0xF) == self.STT_SECTION:
+                                        name = section
+                                file.write('{:08x} {} {}\t{:08x} {}\n'.format(value, flags, section, size, name))
+                        file.write('\n\n')
 
 def insert(rom):
         where = int(args.offset, 16)
@@ -178,72 +227,270 @@ def ReplaceBytes(rom: _io.BufferedReader, offset: int, data: str):
         rom.write(bytes(intByte.to_bytes(1, 'big')))
         ar += 1
 
-shutil.copyfile(args.input, args.output)
-with open(args.output, 'rb+') as rom:
-        offset = get_text_section()
-        table = symbols(offset)
-        where = insert(rom)
-        # Adjust symbol table
-        for entry in table:
-                table[entry] += where
-
-        # Read hooks from a file
-        with open('hooks', 'r') as hooklist:
-                for line in hooklist:
-                        if line.strip().startswith('#'): continue
-                        
-                        symbol, address, register = line.split()
-                        offset = int(address, 16) - 0x08000000
-                        try:
-                                code = table[symbol]
-                        except KeyError:
-                                print('Symbol missing:', symbol)
+class JournaledRom:
+        # Stands in for the output file while patching: keeps every write in
+        # order so they can be applied in one pass and recorded in the journal.
+        def __init__(self):
+                self.writes = []
+                self.position = 0
+
+        def seek(self, position):
+                self.position = position
+
+        def write(self, data):
+                self.writes.append((self.position, bytes(data)))
+                self.position += len(data)
+
+def merge_ranges(ranges):
+        merged = []
+        for start, end in sorted(ranges):
+                if merged and start <= merged[-1][1]:
+                        merged[-1][1] = max(merged[-1][1], end)
+                else:
+                        merged.append([start, end])
+        return merged
+
+def file_stamp(path):
+        info = os.stat(path)
+        return [info.st_size, info.st_mtime_ns]
+
+def read_journal():
+        # Ranges written by the last run, if it patched the same input into the same output.
+        try:
+                with open(args.journal, 'r') as journal:
+                        record = json.load(journal)
+        except (OSError, ValueError):
+                return None
+
+        if record.get('input') != args.input or record.get('input_stamp') != file_stamp(args.input):
+                return None
+        if record.get('output') != args.output or not os.path.isfile(args.output):
+                return None
+        return [list(r) for r in record['ranges']]
+
+def write_journal(ranges):
+        with open(args.journal, 'w') as journal:
+                json.dump({'input': args.input, 'input_stamp': file_stamp(args.input),
+                           'output': args.output, 'ranges': ranges}, journal)
+
+def matches_outside(out, base, ranges, chunk=0x100000):
+        # Compares everything but the journaled ranges, a chunk at a time.
+        # Past the end of the input the output holds zeros, as apply_full leaves it.
+        start = 0
+        for range_start, range_end in ranges + [[len(out), len(out)]]:
+                for pos in range(start, min(range_start, len(out)), chunk):
+                        end = min(pos + chunk, range_start, len(out))
+                        wanted = base[pos:end]
+                        if out[pos:end] != wanted + bytes(end - pos - len(wanted)):
+                                return False
+                start = max(start, range_end)
+        return True
+
+def output_size(ranges):
+        # Writes past the end of the input grow the output to reach them.
+        return max([os.path.getsize(args.input)] + [end for start, end in ranges])
+
+def patched_bytes(base, writes, start, end):
+        # What [start, end) holds once the writes are applied to the input.
+        wanted = bytearray(base[start:end])
+        wanted.extend(bytes(end - start - len(wanted)))
+        for offset, data in writes:
+                lo = max(offset, start)
+                hi = min(offset + len(data), end)
+                if lo < hi:
+                        wanted[lo - start:hi - start] = data[lo - offset:hi - offset]
+        return bytes(wanted)
+
+def apply_full(writes):
+        shutil.copyfile(args.input, args.output)
+        with open(args.output, 'rb+') as out:
+                for offset, data in writes:
+                        out.seek(offset)
+                        out.write(data)
+
+def apply_incremental(writes, ranges, old_ranges):
+        # Rebuilds what every range written now or last time should hold (the
+        # input bytes with this run's writes on top) and stores only the ranges
+        # that differ from what the output already has. The output is grown or
+        # cut to size first when the code now ends somewhere else past the input.
+        if os.path.getsize(args.output) != output_size(old_ranges):
+                return False
+
+        size = output_size(ranges)
+        with open(args.output, 'rb+') as out_file:
+                out_file.truncate(size)
+
+        with open(args.input, 'rb') as base_file, open(args.output, 'rb+') as out_file, \
+             mmap.mmap(base_file.fileno(), 0, access=mmap.ACCESS_READ) as base, \
+             mmap.mmap(out_file.fileno(), 0) as out:
+                if not matches_outside(out, base, old_ranges):
+                        print('Output no longer matches ' + args.input + ', rebuilding it.')
+                        return False
+
+                rewritten = 0
+                for start, end in merge_ranges(ranges + old_ranges):
+                        end = min(end, size)
+                        if start >= end:
                                 continue
+                        wanted = patched_bytes(base, writes, start, end)
+                        if out[start:end] != wanted:
+                                out[start:end] = wanted
+                                rewritten += end - start
 
-                        hook(rom, code, offset, int(register))
+                out.flush()
+                print('Rewrote ' + str(rewritten) + ' bytes of ' + args.output + '.')
+                return True
 
-        if os.path.isfile("bytereplacement"):
-            with open("bytereplacement", 'r') as replacelist:
-                definesDict = {}
-                conditionals = []
-                for line in replacelist:
-                    if TryProcessFileInclusion(line, definesDict):
-                        continue
-                    if TryProcessConditionalCompilation(line, definesDict, conditionals):
-                        continue
-                    if line.strip().startswith('#') or line.strip() == '':
-                        continue
- 
-                    offset = int(line[:8], 16) - 0x08000000
-                    try:
-                        ReplaceBytes(rom, offset, line[9:].strip())
-                    except ValueError: #Try loading from the defines dict if unrecognizable character
-                        newNumber = definesDict[line[9:].strip()]
-                        try:
-                            newNumber = int(newNumber)
-                        except ValueError:
-                            newNumber = int(newNumber, 16)
-
-                        newNumber = str(hex(newNumber)).split('0x')[1]
-                        ReplaceBytes(rom, offset, newNumber) 
-        if os.path.isfile("routinepointers"):
-            with open("routinepointers", 'r') as pointerlist:
-                definesDict = {}
-                conditionals = []
-                for line in pointerlist:
-                    if TryProcessFileInclusion(line, definesDict):
-                        continue
-                    if TryProcessConditionalCompilation(line, definesDict, conditionals):
-                        continue
-                    if line.strip().startswith('#') or line.strip() == '':
-                        continue
+def bps_number(value):
+        encoded = bytearray()
+        while True:
+                low = value & 0x7F
+                value >>= 7
+                if value == 0:
+                        encoded.append(0x80 | low)
+                        return encoded
+                encoded.append(low)
+                value -= 1
+
+def write_bps(path, writes, ranges):
+        # Built straight from the journal: untouched stretches are SourceRead
+        # actions and the written ranges TargetRead actions. Only the CRCs
+        # need a pass over the input.
+        with open(args.input, 'rb') as base_file, \
+             mmap.mmap(base_file.fileno(), 0, access=mmap.ACCESS_READ) as base:
+                source_size = len(base)
+                target_size = max([source_size] + [end for start, end in ranges])
+                patch = bytearray(b'BPS1')
+                patch += bps_number(source_size) + bps_number(target_size) + bps_number(0)
+                target_crc = 0
+                position = 0
+
+                def unchanged(end):
+                        nonlocal patch, target_crc
+                        copy_end = min(end, source_size)
+                        if position < copy_end:
+                                patch += bps_number(((copy_end - position - 1) << 2) | 0)
+                                target_crc = zlib.crc32(base[position:copy_end], target_crc)
+                        if max(position, copy_end) < end:
+                                changed(bytes(end - max(position, copy_end)))
+
+                def changed(data):
+                        nonlocal patch, target_crc
+                        patch += bps_number(((len(data) - 1) << 2) | 1) + data
+                        target_crc = zlib.crc32(data, target_crc)
 
-                    symbol, address = line.split()
-                    offset = int(address, 16) - 0x08000000
-                    try:
+                for start, end in ranges:
+                        unchanged(start)
+                        changed(patched_bytes(base, writes, start, end))
+                        position = end
+                unchanged(target_size)
+
+                patch += zlib.crc32(base).to_bytes(4, 'little')
+                patch += target_crc.to_bytes(4, 'little')
+                patch += zlib.crc32(patch).to_bytes(4, 'little')
+
+        with open(path, 'wb') as file:
+                file.write(patch)
+
+def write_ips(path, writes, ranges):
+        with open(args.input, 'rb') as base_file, \
+             mmap.mmap(base_file.fileno(), 0, access=mmap.ACCESS_READ) as base:
+                patch = bytearray(b'PATCH')
+                for start, end in ranges:
+                        for offset in range(start, end, 0x8000):
+                                record_end = min(offset + 0x8000, end)
+                                # An offset spelling "EOF" would end the patch early.
+                                if offset == 0x454F46:
+                                        offset -= 1
+                                if record_end > 0x1000000:
+                                        print('IPS patches can\'t reach ' + hex(record_end - 1) + ', use --bps instead.')
+                                        sys.exit(1)
+                                patch += offset.to_bytes(3, 'big') + (record_end - offset).to_bytes(2, 'big')
+                                patch += patched_bytes(base, writes, offset, record_end)
+                patch += b'EOF'
+
+        with open(path, 'wb') as file:
+                file.write(patch)
+
+rom = JournaledRom()
+elf = ElfFile(args.elf)
+if args.symbols:
+        elf.write_symbols(args.symbols)
+text_address = elf.sections['.text'][1]
+table = elf.section_symbols('.text')
+where = insert(rom)
+# Adjust symbol table
+for entry in table:
+        table[entry] += where - text_address
+
+# Read hooks from a file
+with open('hooks', 'r') as hooklist:
+        for line in hooklist:
+                if line.strip().startswith('#'): continue
+
+                symbol, address, register = line.split()
+                offset = int(address, 16) - 0x08000000
+                try:
                         code = table[symbol]
-                    except KeyError:
+                except KeyError:
                         print('Symbol missing:', symbol)
                         continue
 
-                    Repoint(rom, code, offset, 1)
+                hook(rom, code, offset, int(register))
+
+if os.path.isfile("bytereplacement"):
+    with open("bytereplacement", 'r') as replacelist:
+        definesDict = {}
+        conditionals = []
+        for line in replacelist:
+            if TryProcessFileInclusion(line, definesDict):
+                continue
+            if TryProcessConditionalCompilation(line, definesDict, conditionals):
+                continue
+            if line.strip().startswith('#') or line.strip() == '':
+                continue
+
+            offset = int(line[:8], 16) - 0x08000000
+            try:
+                ReplaceBytes(rom, offset, line[9:].strip())
+            except ValueError: #Try loading from the defines dict if unrecognizable character
+                newNumber = definesDict[line[9:].strip()]
+                try:
+                    newNumber = int(newNumber)
+                except ValueError:
+                    newNumber = int(newNumber, 16)
+
+                newNumber = str(hex(newNumber)).split('0x')[1]
+                ReplaceBytes(rom, offset, newNumber) 
+if os.path.isfile("routinepointers"):
+    with open("routinepointers", 'r') as pointerlist:
+        definesDict = {}
+        conditionals = []
+        for line in pointerlist:
+            if TryProcessFileInclusion(line, definesDict):
+                continue
+            if TryProcessConditionalCompilation(line, definesDict, conditionals):
+                continue
+            if line.strip().startswith('#') or line.strip() == '':
+                continue
+
+            symbol, address = line.split()
+            offset = int(address, 16) - 0x08000000
+            try:
+                code = table[symbol]
+            except KeyError:
+                print('Symbol missing:', symbol)
+                continue
+
+            Repoint(rom, code, offset, 1)
+
+ranges = merge_ranges([(offset, offset + len(data)) for offset, data in rom.writes])
+old_ranges = read_journal() if args.incremental else None
+if old_ranges is None or not apply_incremental(rom.writes, ranges, old_ranges):
+        apply_full(rom.writes)
+write_journal(ranges)
+
+if args.bps:
+        write_bps(args.bps, rom.writes, ranges)
+if args.ips:
+        write_ips(args.ips, rom.writes, ranges)
@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+
+import os
+import re
+import sys
+import argparse
+from fractions import Fraction
+
+if sys.version_info < (3, 4):
+        print('Python 3.4 or later is required.')
+        sys.exit(1)
+
+# Parse arguments
+parser = argparse.ArgumentParser(description='Build the alias table minigame.c draws buried items from.')
+parser.add_argument('--weights', metavar='file',
+                    help='item weights, one "item weight" per line', default='src/excavation_loot.txt')
+parser.add_argument('--output', metavar='file',
+                    help='header to write the table to', default='src/loot_table.h')
+args = parser.parse_args()
+
+# Thresholds are out of this, compared against 16 random bits
+ONE = 0x10000
+
+def read_weights(path):
+        weights = []
+        with open(path, 'r') as file:
+                for number, line in enumerate(file, 1):
+                        line = line.split('#', 1)[0].strip()
+                        if not line:
+                                continue
+                        match = re.match(r'^(\w+)\s+(\d+)$', line)
+                        if match is None:
+                                raise SystemExit('{}:{}: expected "item weight"'.format(path, number))
+                        weights.append((match.group(1), int(match.group(2))))
+
+        if not weights or sum(weight for item, weight in weights) == 0:
+                raise SystemExit('{}: no item has any weight'.format(path))
+        return weights
+
+def build_alias_table(weights):
+        # Vose's method: every column starts with its item's share scaled so that the
+        # shares average 1, and each column short of 1 is topped up from one over it.
+        # A column then holds its own item below the threshold and its alias above.
+        total = sum(weight for item, weight in weights)
+        share = [Fraction(weight * len(weights), total) for item, weight in weights]
+        alias = list(range(len(weights)))
+        small = [i for i, s in enumerate(share) if s < 1]
+        large = [i for i, s in enumerate(share) if s >= 1]
+
+        while small and large:
+                less = small.pop()
+                more = large.pop()
+                alias[less] = more
+                share[more] -= 1 - share[less]
+                (small if share[more] < 1 else large).append(more)
+
+        # What's left is 1 up to rounding; such columns never need their alias
+        for i in small + large:
+                share[i] = Fraction(1)
+                alias[i] = i
+
+        table = []
+        for i, (item, weight) in enumerate(weights):
+                threshold = min(int(round(share[i] * ONE)), ONE - 1)
+                # A full column is its own alias, so the clamped threshold doesn't matter
+                table.append((item, weights[alias[i]][0], threshold))
+        return table
+
+def write_table(path, table):
+        lines = ['// Generated by scripts/loot_table.py from {}. Do not edit.'.format(args.weights),
+                 '',
+                 '#define LOOT_TABLE_SIZE {}'.format(len(table)),
+                 '',
+                 '// A column of the alias table: itemId if the coin is under threshold (out of 0x10000), aliasItemId otherwise',
+                 'struct LootEntry',
+                 '{',
+                 '    u8 itemId;',
+                 '    u8 aliasItemId;',
+                 '    u16 threshold;',
+                 '};',
+                 '',
+                 'static const struct LootEntry sLootTable[LOOT_TABLE_SIZE] = {']
+        for item, alias, threshold in table:
+                lines.append('    {{{}, {}, 0x{:04X}}},'.format(item, alias, threshold))
+        lines.append('};')
+
+        os.makedirs(os.path.dirname(path) or '.', exist_ok=True)
+        with open(path, 'w') as file:
+                file.write('\n'.join(lines) + '\n')
+
+write_table(args.output, build_alias_table(read_weights(args.weights)))
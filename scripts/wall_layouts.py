@@ -0,0 +1,182 @@
+#!/usr/bin/env python3
+
+import os
+import re
+import sys
+import random
+import argparse
+
+if sys.version_info < (3, 4):
+        print('Python 3.4 or later is required.')
+        sys.exit(1)
+
+# Parse arguments
+parser = argparse.ArgumentParser(description='Prebuild a bank of excavation walls for minigame.c to pick from.')
+parser.add_argument('--source', metavar='file',
+                    help='C file with the item and stone definitions', default='src/minigame.c')
+parser.add_argument('--header', metavar='file',
+                    help='header with the item and stone ids', default='src/excavation.h')
+parser.add_argument('--loot', metavar='file',
+                    help='item weights, one "item weight" per line', default='src/excavation_loot.txt')
+parser.add_argument('--output', metavar='file',
+                    help='header to write the bank to', default='src/wall_layouts.h')
+parser.add_argument('--count', metavar='n',
+                    help='number of walls in the bank', default='512')
+parser.add_argument('--seed', metavar='n',
+                    help='seed for the generator, so the bank is the same on every build', default='0')
+parser.add_argument('--max-rare', metavar='n',
+                    help='most rare items (those of the lowest weight) a wall may hold', default=None)
+args = parser.parse_args()
+
+WALL_WIDTH = 12
+WALL_HEIGHT = 8
+NUM_STONES = 2
+
+# Odds of the optional zones, as Excavation_Init rolls them on the device.
+# Zones 1 and 4 always hold an item. Out of 256: no more items, zone 3 too, zones 2 and 3 too.
+EXTRA_ZONE_ODDS = [([], 85), ([2], 100), ([1, 2], 71)]
+
+def read_defines(path):
+        with open(path, 'r') as file:
+                text = file.read()
+        return {name: int(value, 0) for name, value in re.findall(r'#define\s+(\w+)\s+(\d+|0x[0-9A-Fa-f]+)\b', text)}
+
+def read_table(text, name):
+        match = re.search(r'\b' + name + r'\[[^\]]*\]\s*=\s*\{(.*?)\n\};', text, re.S)
+        if match is None:
+                raise SystemExit('{}: no definition of {}'.format(args.source, name))
+        return match.group(1)
+
+def read_shapes(text, name, ids):
+        shapes = {}
+        for key, body in re.findall(r'\[(\w+)\]\s*=\s*\{(.*?)\n    \}', read_table(text, name), re.S):
+                shape = re.search(r'\.shape\s*=\s*SHAPE\(([^)]*)\)', body)
+                if shape is None:
+                        raise SystemExit('{}: {} has no shape'.format(args.source, key))
+                rows = [int(row, 0) for row in shape.group(1).split(',')]
+                cells = [(x, y) for y, row in enumerate(rows) for x in range(4) if row & (1 << x)]
+                if cells:
+                        shapes[ids[key]] = cells
+        return shapes
+
+def read_zones(text):
+        zones = []
+        for zone in re.findall(r'\{([^{}]*)\}', read_table(text, 'sItemZones')):
+                zones.append([int(value, 0) for value in zone.split(',')])
+        return zones
+
+# Same format as scripts/loot_table.py reads
+def read_weights(path, ids):
+        weights = []
+        with open(path, 'r') as file:
+                for number, line in enumerate(file, 1):
+                        line = line.split('#', 1)[0].strip()
+                        if not line:
+                                continue
+                        match = re.match(r'^(\w+)\s+(\d+)$', line)
+                        if match is None or match.group(1) not in ids:
+                                raise SystemExit('{}:{}: expected "item weight"'.format(path, number))
+                        weights.append((ids[match.group(1)], int(match.group(2))))
+
+        if not weights or sum(weight for item, weight in weights) == 0:
+                raise SystemExit('{}: no item has any weight'.format(path))
+        return weights
+
+class Wall:
+        def __init__(self):
+                self.occupied = set()
+
+        def anchors(self, cells, zone):
+                # Same candidates as Wall_FindAnchor: inside the zone and clear of everything placed so far
+                left, top, right, bottom = zone
+                width = max(x for x, y in cells) + 1
+                height = max(y for x, y in cells) + 1
+                return [x + y * WALL_WIDTH
+                        for y in range(top, bottom - height + 2)
+                        for x in range(left, right - width + 2)
+                        if not any((x + dx + (y + dy) * WALL_WIDTH) in self.occupied for dx, dy in cells)]
+
+        def place(self, cells, anchor):
+                self.occupied.update(anchor + dx + dy * WALL_WIDTH for dx, dy in cells)
+
+def roll(rng, choices):
+        pick = rng.randrange(sum(weight for choice, weight in choices))
+        for choice, weight in choices:
+                if pick < weight:
+                        return choice
+                pick -= weight
+
+def generate(rng, items, stones, zones, weights, max_rare):
+        rare_weight = min(weight for item, weight in weights if weight > 0)
+
+        while True:
+                wall = Wall()
+                layout = {'items': [(0, 0)] * len(zones), 'stones': [(0, 0)] * NUM_STONES}
+                rare = 0
+
+                for zone in [0, len(zones) - 1] + roll(rng, EXTRA_ZONE_ODDS):
+                        item = roll(rng, weights)
+                        rare += dict(weights)[item] == rare_weight
+                        anchor = rng.choice(wall.anchors(items[item], zones[zone]))
+                        wall.place(items[item], anchor)
+                        layout['items'][zone] = (item, anchor)
+
+                # Like DoDrawRandomStone, a stone that fits nowhere around the items is left out
+                for i in range(NUM_STONES):
+                        stone = rng.choice(sorted(stones))
+                        anchors = wall.anchors(stones[stone], (0, 0, WALL_WIDTH - 1, WALL_HEIGHT - 1))
+                        if not anchors:
+                                continue
+                        anchor = rng.choice(anchors)
+                        wall.place(stones[stone], anchor)
+                        layout['stones'][i] = (stone, anchor)
+
+                # Walls are thrown away here rather than fixed up, so the ones kept have the odds the device had
+                if max_rare is not None and rare > max_rare:
+                        continue
+
+                layout['terrain'] = rng.randrange(0x10000)
+                return layout
+
+def write_bank(path, layouts):
+        lines = ['// Generated by scripts/wall_layouts.py from {}. Do not edit.'.format(args.source),
+                 '',
+                 '#define WALL_LAYOUT_COUNT {}'.format(len(layouts)),
+                 '',
+                 '// One prebuilt wall. Zone n holds item itemIds[n] (ITEMID_NONE if it\'s empty), the top left corner',
+                 '// of its shape at cell itemAnchors[n] (x + y * WALL_WIDTH). Stones likewise, ITEMID_NONE for one left out.',
+                 'struct WallLayout',
+                 '{',
+                 '    u16 terrainSeed;',
+                 '    u8 itemIds[MAX_NUM_BURIED_ITEMS];',
+                 '    u8 itemAnchors[MAX_NUM_BURIED_ITEMS];',
+                 '    u8 stoneIds[{}];'.format(NUM_STONES),
+                 '    u8 stoneAnchors[{}];'.format(NUM_STONES),
+                 '};',
+                 '',
+                 'static const struct WallLayout sWallLayouts[WALL_LAYOUT_COUNT] = {']
+        for layout in layouts:
+                lines.append('    {{0x{:04X}, {{{}}}, {{{}}}, {{{}}}, {{{}}}}},'.format(
+                        layout['terrain'],
+                        ', '.join(str(item) for item, anchor in layout['items']),
+                        ', '.join(str(anchor) for item, anchor in layout['items']),
+                        ', '.join(str(stone) for stone, anchor in layout['stones']),
+                        ', '.join(str(anchor) for stone, anchor in layout['stones'])))
+        lines.append('};')
+
+        os.makedirs(os.path.dirname(path) or '.', exist_ok=True)
+        with open(path, 'w') as file:
+                file.write('\n'.join(lines) + '\n')
+
+ids = read_defines(args.header)
+with open(args.source, 'r') as file:
+        source = file.read()
+
+items = read_shapes(source, 'ExcavationItemList', ids)
+stones = read_shapes(source, 'ExcavationStoneList', ids)
+zones = read_zones(source)
+weights = read_weights(args.loot, ids)
+max_rare = int(args.max_rare, 0) if args.max_rare is not None else None
+
+rng = random.Random(int(args.seed, 0))
+write_bank(args.output, [generate(rng, items, stones, zones, weights, max_rare) for i in range(int(args.count, 0))])
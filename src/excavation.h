@@ -19,13 +19,21 @@
 
 /*********** DEBUG SWITCHES ************/
 // #define DEBUG_ITEM_GEN
+// Generate walls on the device instead of picking one of the prebuilt ones (see scripts/wall_layouts.py)
+// #define EXCAVATION_RUNTIME_WALLS
+// Start every wall from this seed instead of a random one, to replay the same wall
+// #define EXCAVATION_FIXED_SEED 0x00000000
 
 #define SELECTED          0
 #define DESELECTED        255
-#define ITEM_TILE_NONE    0
-#define ITEM_TILE_DUG_UP  5
 #define MAX_NUM_BURIED_ITEMS 4
 
+/*********** WALL ************/
+#define WALL_WIDTH        12
+#define WALL_HEIGHT       8
+#define WALL_PLANE_WORDS  3  // 96 cells, one bit each
+#define LAYER_CLEARED     6
+
 /*********** ITEM/STONE IDS ************/
 #define ITEMID_NONE                     0
 #define ITEMID_HARD_STONE               1
@@ -31,6 +31,21 @@
 #include "new/Vanilla_functions.h"
 #include "new_menu_helpers.h"
 
+// Atlas frame n's tiles are loaded with tag ATLAS_TILE_TAG + n
+#define ATLAS_TILE_TAG 0x100
+#ifdef DEBUG_ITEM_GEN
+#define ATLAS_OAM_PRIORITY 0
+#else
+#define ATLAS_OAM_PRIORITY 3
+#endif
+#include "../graphics/excavation/sprites_atlas.h"
+#include "crack_strips.h"
+#ifdef EXCAVATION_RUNTIME_WALLS
+#include "loot_table.h"
+#else
+#include "wall_layouts.h"
+#endif
+
 enum {
     BG_COORD_SET,
     BG_COORD_ADD,
@@ -70,10 +85,15 @@ static void Excavation_LoadSpriteGraphics(void);
 static void Excavation_FreeResources(void);
 static void Excavation_UpdateCracks(void);
 static void Excavation_UpdateTerrain(void);
-static void Excavation_DrawRandomTerrain(void);
+static void Excavation_DrawRandomTerrain(u32 seed);
+static void Excavation_CopyDirtyTilemapRows(void);
+#ifdef EXCAVATION_RUNTIME_WALLS
 static void DoDrawRandomItem(u8 itemStateId, u8 itemId);
 static void DoDrawRandomStone(u8 itemId);
-static void Excavation_CheckItemFound(void);
+#else
+static void Excavation_LoadWallLayout(const struct WallLayout *layout);
+#endif
+static void Excavation_FlashFoundItems(void);
 static void PrintMessage(const u8 *string);
 static void InitMiningWindows(void);
 static u32 GetCrackPosition(void);
@@ -101,6 +121,12 @@ struct BuriedItem
     bool32 status;
 };
 
+// One bit per wall cell: cell x + y * WALL_WIDTH is bit n % 32 of word n / 32
+struct WallPlane
+{
+    u32 words[WALL_PLANE_WORDS];
+};
+
 struct ExcavationState
 {
     MainCallback leavingCallback;
@@ -113,25 +139,24 @@ struct ExcavationState
     u32 crackPos;
     u32 cursorX;
     u32 cursorY;
-    u32 layerMap[96];
-    u32 itemMap[96];
+    // Layer depth of every cell, bit n of the depth in layer[n]
+    struct WallPlane layer[3];
+    // Cells covered by each buried item, and by the stones
+    struct WallPlane itemPlane[MAX_NUM_BURIED_ITEMS];
+    struct WallPlane stonePlane;
     struct BuriedItem buriedItem[4];
 
     // Item 1
     u32 state_item1;
-    u32 Item1_TilesToDigUp;
 
     // Item 2
     u32 state_item2;
-    u32 Item2_TilesToDigUp;
 
     // Item 3
     u32 state_item3;
-    u32 Item3_TilesToDigUp;
 
     // Item 4
     u32 state_item4;
-    u32 Item4_TilesToDigUp;
 
     // Stone 1
     u32 state_stone1;
@@ -139,8 +164,21 @@ struct ExcavationState
     // Stone 2
     u32 state_stone2;
 
+    // OBJ palettes of the items found by the current hit
+    u32 foundPaletteMask;
+
+    u32 seed;
+    u32 rngState;
+    u32 terrainSeed;
+#ifndef EXCAVATION_RUNTIME_WALLS
+    const struct WallLayout *layout;
+#endif
+
     u8 *sBg3TilemapBuffer;
     u8 *sBg2TilemapBuffer;
+
+    // Tiles of BG2 changed since the last VBlank, one bit per column of each tilemap row
+    u32 bg2DirtyColumns[32];
 };
 
 // Win IDs
@@ -158,6 +196,9 @@ struct ExcavationState
 #define TAG_PAL_ITEM3 7
 #define TAG_PAL_ITEM4 8
 
+// Atlas palette n is loaded with tag TAG_PAL_ATLAS + n
+#define TAG_PAL_ATLAS 0x100
+
 #define TAG_PAL_HIT_EFFECTS 9
 #define TAG_HIT_EFFECT_HAMMER 10
 #define TAG_HIT_EFFECT_PICKAXE 11
@@ -488,167 +529,10 @@ static const struct SpriteTemplate gSpriteHitPickaxe = {
     .callback = SpriteCallbackDummy,
 };
 
-static const u16 gStonePal[] = INCBIN_U16("graphics/excavation/stones/stones.gbapal");
-
-static const u32 gStone1x4Gfx[] = INCBIN_U32("graphics/excavation/stones/stone_1x4.4bpp.lz");
-static const u32 gStone4x1Gfx[] = INCBIN_U32("graphics/excavation/stones/stone_4x1.4bpp.lz");
-static const u32 gStone2x4Gfx[] = INCBIN_U32("graphics/excavation/stones/stone_2x4.4bpp.lz");
-static const u32 gStone4x2Gfx[] = INCBIN_U32("graphics/excavation/stones/stone_4x2.4bpp.lz");
-static const u32 gStone2x2Gfx[] = INCBIN_U32("graphics/excavation/stones/stone_2x2.4bpp.lz");
-static const u32 gStone3x3Gfx[] = INCBIN_U32("graphics/excavation/stones/stone_3x3.4bpp.lz");
-
-static const u32 gItemHeartScaleGfx[] = INCBIN_U32("graphics/excavation/items/heart_scale.4bpp.lz");
-static const u16 gItemHeartScalePal[] = INCBIN_U16("graphics/excavation/items/heart_scale.gbapal");
-
-static const u32 gItemHardStoneGfx[] = INCBIN_U32("graphics/excavation/items/hard_stone.4bpp.lz");
-static const u16 gItemHardStonePal[] = INCBIN_U16("graphics/excavation/items/hard_stone.gbapal");
-
-static const u32 gItemReviveGfx[] = INCBIN_U32("graphics/excavation/items/revive.4bpp.lz");
-static const u16 gItemRevivePal[] = INCBIN_U16("graphics/excavation/items/revive.gbapal");
-
-static const u32 gItemStarPieceGfx[] = INCBIN_U32("graphics/excavation/items/star_piece.4bpp.lz");
-static const u16 gItemStarPiecePal[] = INCBIN_U16("graphics/excavation/items/star_piece.gbapal");
-
-static const u32 gItemDampRockGfx[] = INCBIN_U32("graphics/excavation/items/damp_rock.4bpp.lz");
-static const u16 gItemDampRockPal[] = INCBIN_U16("graphics/excavation/items/damp_rock.gbapal");
-
-static const u32 gItemRedShardGfx[] = INCBIN_U32("graphics/excavation/items/red_shard.4bpp.lz");
-static const u16 gItemRedShardPal[] = INCBIN_U16("graphics/excavation/items/red_shard.gbapal");
-
-static const u32 gItemBlueShardGfx[] = INCBIN_U32("graphics/excavation/items/blue_shard.4bpp.lz");
-static const u16 gItemBlueShardPal[] = INCBIN_U16("graphics/excavation/items/blue_shard.gbapal");
-
-static const u32 gItemIronBallGfx[] = INCBIN_U32("graphics/excavation/items/iron_ball.4bpp.lz");
-static const u16 gItemIronBallPal[] = INCBIN_U16("graphics/excavation/items/iron_ball.gbapal");
-
-static const u32 gItemReviveMaxGfx[] = INCBIN_U32("graphics/excavation/items/revive_max.4bpp.lz");
-static const u16 gItemReviveMaxPal[] = INCBIN_U16("graphics/excavation/items/revive_max.gbapal");
-
-static const u32 gItemEverStoneGfx[] = INCBIN_U32("graphics/excavation/items/ever_stone.4bpp.lz");
-static const u16 gItemEverStonePal[] = INCBIN_U16("graphics/excavation/items/ever_stone.gbapal");
-
-// Stone SpriteSheets and SpritePalettes
-static const struct CompressedSpriteSheet sSpriteSheet_Stone1x4[] = {
-    {gStone1x4Gfx, 64 * 64 / 2, TAG_STONE_1X4},
-    {NULL},
-};
-
-static const struct SpritePalette sSpritePal_Stone1x4[] =
-    {
-        {gStonePal, TAG_STONE_1X4},
-        {NULL},
-};
-
-static const struct CompressedSpriteSheet sSpriteSheet_Stone4x1[] = {
-    {gStone4x1Gfx, 64 * 64 / 2, TAG_STONE_4X1},
-    {NULL},
-};
-
-static const struct SpritePalette sSpritePal_Stone4x1[] =
-    {
-        {gStonePal, TAG_STONE_4X1},
-        {NULL},
-};
-
-static const struct CompressedSpriteSheet sSpriteSheet_Stone2x4[] = {
-    {gStone2x4Gfx, 64 * 64 / 2, TAG_STONE_2X4},
-    {NULL},
-};
-
-static const struct SpritePalette sSpritePal_Stone2x4[] =
-    {
-        {gStonePal, TAG_STONE_2X4},
-        {NULL},
-};
-
-static const struct CompressedSpriteSheet sSpriteSheet_Stone4x2[] = {
-    {gStone4x2Gfx, 64 * 64 / 2, TAG_STONE_4X2},
-    {NULL},
-};
-
-static const struct SpritePalette sSpritePal_Stone4x2[] =
-    {
-        {gStonePal, TAG_STONE_4X2},
-        {NULL},
-};
-
-static const struct CompressedSpriteSheet sSpriteSheet_Stone2x2[] = {
-    {gStone2x2Gfx, 64 * 64 / 2, TAG_STONE_2X2},
-    {NULL},
-};
-
-static const struct SpritePalette sSpritePal_Stone2x2[] =
-    {
-        {gStonePal, TAG_STONE_2X2},
-        {NULL},
-};
-
-static const struct CompressedSpriteSheet sSpriteSheet_Stone3x3[] = {
-    {gStone3x3Gfx, 64 * 64 / 2, TAG_STONE_3X3},
-    {NULL},
-};
-
-static const struct SpritePalette sSpritePal_Stone3x3[] =
-    {
-        {gStonePal, TAG_STONE_3X3},
-        {NULL},
-};
-
-// Item SpriteSheets and SpritePalettes
-static const struct CompressedSpriteSheet sSpriteSheet_ItemHeartScale = {
-    gItemHeartScaleGfx,
-    64 * 64 / 2,
-    TAG_ITEM_HEARTSCALE,
-};
-
-static const struct CompressedSpriteSheet sSpriteSheet_ItemHardStone = {
-    gItemHardStoneGfx,
-    64 * 64 / 2,
-    TAG_ITEM_HARDSTONE,
-};
-
-static const struct CompressedSpriteSheet sSpriteSheet_ItemRevive = {
-    gItemReviveGfx,
-    64 * 64 / 2,
-    TAG_ITEM_REVIVE,
-};
-
-static const struct CompressedSpriteSheet sSpriteSheet_ItemStarPiece = {
-    gItemStarPieceGfx,
-    64 * 64 / 2,
-    TAG_ITEM_STAR_PIECE,
-};
-
-static const struct CompressedSpriteSheet sSpriteSheet_ItemDampRock = {
-    gItemDampRockGfx,
-    64 * 64 / 2,
-    TAG_ITEM_DAMP_ROCK,
-};
-
-static const struct CompressedSpriteSheet sSpriteSheet_ItemRedShard = {
-    gItemRedShardGfx,
-    64 * 64 / 2,
-    TAG_ITEM_RED_SHARD};
-
-static const struct CompressedSpriteSheet sSpriteSheet_ItemBlueShard = {
-    gItemBlueShardGfx,
-    64 * 64 / 2,
-    TAG_ITEM_BLUE_SHARD};
-
-static const struct CompressedSpriteSheet sSpriteSheet_ItemIronBall = {
-    gItemIronBallGfx,
-    64 * 64 / 2,
-    TAG_ITEM_IRON_BALL};
-
-static const struct CompressedSpriteSheet sSpriteSheet_ItemReviveMax = {
-    gItemReviveMaxGfx,
-    64 * 64 / 2,
-    TAG_ITEM_REVIVE_MAX};
-
-static const struct CompressedSpriteSheet sSpriteSheet_ItemEverStone = {
-    gItemEverStoneGfx,
-    64 * 64 / 2,
-    TAG_ITEM_EVER_STONE};
+// Item and stone frames, trimmed and packed by gbagfx (see graphics/excavation/sprites.atlas)
+static const u32 gExcavationSpritesGfx[] = INCBIN_U32("graphics/excavation/sprites.4bpp");
+// The frames' palettes, merged into ATLAS_PALETTE_COUNT 16-color palettes
+static const u16 gExcavationSpritesPal[] = INCBIN_U16("graphics/excavation/sprites.gbapal");
 
 static const struct OamData gOamItem32x32 = {
     .y = 0,
@@ -668,84 +552,6 @@ static const struct OamData gOamItem32x32 = {
     .paletteNum = 0,
 };
 
-static const struct OamData gOamItem64x64 = {
-    .y = 0,
-    .affineMode = 0,
-    .objMode = 0,
-    .bpp = 0,
-    .shape = 0,
-    .x = 0,
-    .matrixNum = 0,
-    .size = 3,
-    .tileNum = 0,
-#ifdef DEBUG_ITEM_GEN
-    .priority = 0,
-#else
-    .priority = 3,
-#endif
-    .paletteNum = 0,
-};
-
-static const struct SpriteTemplate gSpriteStone1x4 = {
-    .tileTag = TAG_STONE_1X4,
-    .paletteTag = TAG_STONE_1X4,
-    .oam = &gOamItem64x64,
-    .anims = gDummySpriteAnimTable,
-    .images = NULL,
-    .affineAnims = gDummySpriteAffineAnimTable,
-    .callback = SpriteCallbackDummy,
-};
-
-static const struct SpriteTemplate gSpriteStone4x1 = {
-    .tileTag = TAG_STONE_4X1,
-    .paletteTag = TAG_STONE_4X1,
-    .oam = &gOamItem64x64,
-    .anims = gDummySpriteAnimTable,
-    .images = NULL,
-    .affineAnims = gDummySpriteAffineAnimTable,
-    .callback = SpriteCallbackDummy,
-};
-
-static const struct SpriteTemplate gSpriteStone2x4 = {
-    .tileTag = TAG_STONE_2X4,
-    .paletteTag = TAG_STONE_2X4,
-    .oam = &gOamItem64x64,
-    .anims = gDummySpriteAnimTable,
-    .images = NULL,
-    .affineAnims = gDummySpriteAffineAnimTable,
-    .callback = SpriteCallbackDummy,
-};
-
-static const struct SpriteTemplate gSpriteStone4x2 = {
-    .tileTag = TAG_STONE_4X2,
-    .paletteTag = TAG_STONE_4X2,
-    .oam = &gOamItem64x64,
-    .anims = gDummySpriteAnimTable,
-    .images = NULL,
-    .affineAnims = gDummySpriteAffineAnimTable,
-    .callback = SpriteCallbackDummy,
-};
-
-static const struct SpriteTemplate gSpriteStone2x2 = {
-    .tileTag = TAG_STONE_2X2,
-    .paletteTag = TAG_STONE_2X2,
-    .oam = &gOamItem64x64,
-    .anims = gDummySpriteAnimTable,
-    .images = NULL,
-    .affineAnims = gDummySpriteAffineAnimTable,
-    .callback = SpriteCallbackDummy,
-};
-
-static const struct SpriteTemplate gSpriteStone3x3 = {
-    .tileTag = TAG_STONE_3X3,
-    .paletteTag = TAG_STONE_3X3,
-    .oam = &gOamItem64x64,
-    .anims = gDummySpriteAnimTable,
-    .images = NULL,
-    .affineAnims = gDummySpriteAffineAnimTable,
-    .callback = SpriteCallbackDummy,
-};
-
 struct ExcavationItem
 {
     u32 excItemId;
@@ -753,8 +559,9 @@ struct ExcavationItem
     u32 top;        // starts with 0
     u32 left;       // starts with 0
     u32 totalTiles; // starts with 0
+    u32 shape;      // see SHAPE
     u32 tag;
-    const struct CompressedSpriteSheet *sheet;
+    u32 frame;
 };
 
 struct ExcavationStone
@@ -762,8 +569,15 @@ struct ExcavationStone
     u32 excStoneId;
     u32 top;  // starts with 0
     u32 left; // starts with 0
+    u32 shape; // see SHAPE
+    u32 tag;
+    u32 frame;
 };
 
+// The cells an item or stone covers, on a 4x4 grid: bit x of each row is column x
+#define SHAPE(row0, row1, row2, row3) ((row0) | ((row1) << 4) | ((row2) << 8) | ((row3) << 12))
+#define SHAPE_SIZE 16
+
 static const struct ExcavationItem ExcavationItemList[] = {
     [ITEMID_NONE] = {
         .excItemId = ITEMID_NONE,
@@ -771,8 +585,9 @@ static const struct ExcavationItem ExcavationItemList[] = {
         .top = 0,
         .left = 0,
         .totalTiles = 0,
+        .shape = SHAPE(0x0, 0x0, 0x0, 0x0),
         .tag = 0,
-        .sheet = NULL,
+        .frame = 0,
     },
     [ITEMID_HARD_STONE] = {
         .excItemId = ITEMID_HARD_STONE,
@@ -780,8 +595,9 @@ static const struct ExcavationItem ExcavationItemList[] = {
         .top = 1,
         .left = 1,
         .totalTiles = 3,
+        .shape = SHAPE(0x3, 0x3, 0x0, 0x0),
         .tag = TAG_ITEM_HARDSTONE,
-        .sheet = &sSpriteSheet_ItemHardStone,
+        .frame = ATLAS_HARD_STONE,
     },
     [ITEMID_REVIVE] = {
         .excItemId = ITEMID_REVIVE,
@@ -789,8 +605,9 @@ static const struct ExcavationItem ExcavationItemList[] = {
         .top = 2,
         .left = 2,
         .totalTiles = 4,
+        .shape = SHAPE(0x2, 0x7, 0x2, 0x0),
         .tag = TAG_ITEM_REVIVE,
-        .sheet = &sSpriteSheet_ItemRevive,
+        .frame = ATLAS_REVIVE,
     },
     [ITEMID_STAR_PIECE] = {
         .excItemId = ITEMID_STAR_PIECE,
@@ -798,8 +615,9 @@ static const struct ExcavationItem ExcavationItemList[] = {
         .top = 2,
         .left = 2,
         .totalTiles = 4,
+        .shape = SHAPE(0x2, 0x7, 0x2, 0x0),
         .tag = TAG_ITEM_STAR_PIECE,
-        .sheet = &sSpriteSheet_ItemStarPiece,
+        .frame = ATLAS_STAR_PIECE,
     },
     [ITEMID_DAMP_ROCK] = {
         .excItemId = ITEMID_DAMP_ROCK,
@@ -808,8 +626,9 @@ static const struct ExcavationItem ExcavationItemList[] = {
         .top = 2,
         .left = 2,
         .totalTiles = 7,
+        .shape = SHAPE(0x7, 0x7, 0x5, 0x0),
         .tag = TAG_ITEM_DAMP_ROCK,
-        .sheet = &sSpriteSheet_ItemDampRock,
+        .frame = ATLAS_DAMP_ROCK,
     },
     [ITEMID_RED_SHARD] = {
         .excItemId = ITEMID_RED_SHARD,
@@ -817,8 +636,9 @@ static const struct ExcavationItem ExcavationItemList[] = {
         .top = 2,
         .left = 2,
         .totalTiles = 7,
+        .shape = SHAPE(0x7, 0x3, 0x7, 0x0),
         .tag = TAG_ITEM_RED_SHARD,
-        .sheet = &sSpriteSheet_ItemRedShard,
+        .frame = ATLAS_RED_SHARD,
 
     },
     [ITEMID_BLUE_SHARD] = {
@@ -827,8 +647,9 @@ static const struct ExcavationItem ExcavationItemList[] = {
         .top = 2,
         .left = 2,
         .totalTiles = 7,
+        .shape = SHAPE(0x7, 0x7, 0x3, 0x0),
         .tag = TAG_ITEM_BLUE_SHARD,
-        .sheet = &sSpriteSheet_ItemBlueShard,
+        .frame = ATLAS_BLUE_SHARD,
     },
     [ITEMID_IRON_BALL] = {
         .excItemId = ITEMID_IRON_BALL,
@@ -837,8 +658,9 @@ static const struct ExcavationItem ExcavationItemList[] = {
         .top = 2,
         .left = 2,
         .totalTiles = 8,
+        .shape = SHAPE(0x7, 0x7, 0x7, 0x0),
         .tag = TAG_ITEM_IRON_BALL,
-        .sheet = &sSpriteSheet_ItemIronBall,
+        .frame = ATLAS_IRON_BALL,
     },
     [ITEMID_REVIVE_MAX] = {
         .excItemId = ITEMID_REVIVE_MAX,
@@ -847,8 +669,9 @@ static const struct ExcavationItem ExcavationItemList[] = {
         .top = 2,
         .left = 2,
         .totalTiles = 8,
+        .shape = SHAPE(0x7, 0x7, 0x7, 0x0),
         .tag = TAG_ITEM_REVIVE_MAX,
-        .sheet = &sSpriteSheet_ItemReviveMax,
+        .frame = ATLAS_REVIVE_MAX,
     },
     [ITEMID_EVER_STONE] = {
         .excItemId = ITEMID_EVER_STONE,
@@ -857,8 +680,9 @@ static const struct ExcavationItem ExcavationItemList[] = {
         .top = 1,
         .left = 3,
         .totalTiles = 7,
+        .shape = SHAPE(0xF, 0xF, 0x0, 0x0),
         .tag = TAG_ITEM_EVER_STONE,
-        .sheet = &sSpriteSheet_ItemEverStone,
+        .frame = ATLAS_EVER_STONE,
     },
     [ITEMID_HEART_SCALE] = {
         .excItemId = ITEMID_HEART_SCALE,
@@ -866,8 +690,9 @@ static const struct ExcavationItem ExcavationItemList[] = {
         .top = 1,
         .left = 1,
         .totalTiles = 2,
+        .shape = SHAPE(0x1, 0x3, 0x0, 0x0),
         .tag = TAG_ITEM_HEARTSCALE,
-        .sheet = &sSpriteSheet_ItemHeartScale,
+        .frame = ATLAS_HEART_SCALE,
     },
 };
 
@@ -876,31 +701,49 @@ static const struct ExcavationStone ExcavationStoneList[] = {
         .excStoneId = ID_STONE_1x4,
         .top = 3,
         .left = 0,
+        .shape = SHAPE(0x1, 0x1, 0x1, 0x1),
+        .tag = TAG_STONE_1X4,
+        .frame = ATLAS_STONE_1X4,
     },
     [ID_STONE_4x1] = {
         .excStoneId = ID_STONE_4x1,
         .top = 0,
         .left = 3,
+        .shape = SHAPE(0xF, 0x0, 0x0, 0x0),
+        .tag = TAG_STONE_4X1,
+        .frame = ATLAS_STONE_4X1,
     },
     [ID_STONE_2x4] = {
         .excStoneId = ID_STONE_2x4,
         .top = 3,
         .left = 1,
+        .shape = SHAPE(0x3, 0x3, 0x3, 0x3),
+        .tag = TAG_STONE_2X4,
+        .frame = ATLAS_STONE_2X4,
     },
     [ID_STONE_4x2] = {
         .excStoneId = ID_STONE_4x2,
         .top = 1,
         .left = 3,
+        .shape = SHAPE(0xF, 0xF, 0x0, 0x0),
+        .tag = TAG_STONE_4X2,
+        .frame = ATLAS_STONE_4X2,
     },
     [ID_STONE_2x2] = {
         .excStoneId = ID_STONE_2x2,
         .top = 1,
         .left = 1,
+        .shape = SHAPE(0x3, 0x3, 0x0, 0x0),
+        .tag = TAG_STONE_2X2,
+        .frame = ATLAS_STONE_2X2,
     },
     [ID_STONE_3x3] = {
         .excStoneId = ID_STONE_3x3,
         .top = 2,
         .left = 2,
+        .shape = SHAPE(0x7, 0x7, 0x7, 0x0),
+        .tag = TAG_STONE_3X3,
+        .frame = ATLAS_STONE_3X3,
     },
 };
 
@@ -910,97 +753,308 @@ static const u8 sText_WasObtained[] = _("{STR_VAR_1}\nwas obtained!");
 static const u8 sText_TooBad[] = _("Too bad!\nYour Bag is full!");
 static const u8 sText_TheWall[] = _("The wall collapsed!");
 
-static u32 ExcavationUtil_GetTotalTileAmount(u8 itemId)
+// Cells in the first and last column. Moving a plane one cell sideways wraps these into the neighbouring row.
+static const struct WallPlane sWallColumnFirst = {{0x01001001, 0x10010010, 0x00100100}};
+static const struct WallPlane sWallColumnLast = {{0x00800800, 0x08008008, 0x80080080}};
+// Every cell of the wall
+static const struct WallPlane sWallAll = {{0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF}};
+
+static void Wall_Clear(struct WallPlane *plane)
 {
-    return ExcavationItemList[itemId].totalTiles + 1;
+    plane->words[0] = 0;
+    plane->words[1] = 0;
+    plane->words[2] = 0;
 }
 
-// It will create a random number between 0 and amount-1
-static u32 random(u32 amount)
+static void Wall_SetCell(struct WallPlane *plane, u32 n)
+{
+    plane->words[n / 32] |= 1u << (n % 32);
+}
+
+static bool32 Wall_TestCell(const struct WallPlane *plane, u32 n)
+{
+    return (plane->words[n / 32] >> (n % 32)) & 1;
+}
+
+// Moves every cell n to n + count. Cells moved past the last row drop out. dst may be src.
+static void Wall_ShiftForward(struct WallPlane *dst, const struct WallPlane *src, u32 count)
+{
+    s32 i;
+    s32 from;
+    u32 word;
+    u32 bits = count % 32;
+
+    for (i = WALL_PLANE_WORDS - 1; i >= 0; i--)
+    {
+        from = i - (s32)(count / 32);
+        word = 0;
+        if (from >= 0)
+            word = src->words[from] << bits;
+        if (from >= 1 && bits != 0)
+            word |= src->words[from - 1] >> (32 - bits);
+        dst->words[i] = word;
+    }
+}
+
+// Moves every cell n to n - count. Cells moved above the first row drop out.
+static void Wall_ShiftBack(struct WallPlane *dst, const struct WallPlane *src, u32 count)
+{
+    s32 i;
+    s32 from;
+    u32 word;
+    u32 bits = count % 32;
+
+    for (i = 0; i < WALL_PLANE_WORDS; i++)
+    {
+        from = i + count / 32;
+        word = 0;
+        if (from < WALL_PLANE_WORDS)
+            word = src->words[from] >> bits;
+        if (from < WALL_PLANE_WORDS - 1 && bits != 0)
+            word |= src->words[from + 1] << (32 - bits);
+        dst->words[i] = word;
+    }
+}
+
+// Cells dug down to LAYER_CLEARED (0b110)
+static void Wall_GetCleared(struct WallPlane *cleared)
+{
+    u32 i;
+
+    for (i = 0; i < WALL_PLANE_WORDS; i++)
+        cleared->words[i] = sExcavationUiState->layer[2].words[i] & sExcavationUiState->layer[1].words[i] & ~sExcavationUiState->layer[0].words[i];
+}
+
+static u32 Wall_GetLayer(u32 n)
+{
+    return Wall_TestCell(&sExcavationUiState->layer[0], n)
+         | (Wall_TestCell(&sExcavationUiState->layer[1], n) << 1)
+         | (Wall_TestCell(&sExcavationUiState->layer[2], n) << 2);
+}
+
+static void Wall_SetLayer(u32 n, u32 layer)
 {
-    return (Random() % amount);
+    u32 i;
+
+    for (i = 0; i < 3; i++)
+    {
+        sExcavationUiState->layer[i].words[n / 32] &= ~(1u << (n % 32));
+        sExcavationUiState->layer[i].words[n / 32] |= ((layer >> i) & 1) << (n % 32);
+    }
 }
 
-static void delay(unsigned int amount)
+// Cells covered by any item or stone
+static void Wall_GetOccupied(struct WallPlane *occupied)
 {
     u32 i;
-    for (i = 0; i < amount * 10; i++)
+
+    for (i = 0; i < WALL_PLANE_WORDS; i++)
     {
-    };
+        occupied->words[i] = sExcavationUiState->itemPlane[0].words[i]
+                           | sExcavationUiState->itemPlane[1].words[i]
+                           | sExcavationUiState->itemPlane[2].words[i]
+                           | sExcavationUiState->itemPlane[3].words[i]
+                           | sExcavationUiState->stonePlane.words[i];
+    }
 }
 
-static void UiShake(void)
+// The cells a hit on cell (x, y) digs into: a plus for the pickaxe, the 3x3 square for the hammer
+static void Wall_GetStencil(struct WallPlane *stencil, u32 x, u32 y, bool32 isHammer)
 {
+    struct WallPlane center;
+    struct WallPlane row;
+    struct WallPlane left;
+    struct WallPlane right;
+    struct WallPlane up;
+    struct WallPlane down;
     u32 i;
-    u32 i2;
+
+    Wall_Clear(&center);
+    Wall_SetCell(&center, x + y * WALL_WIDTH);
+
+    // Spread sideways, dropping whatever wrapped into the next or previous row
+    Wall_ShiftForward(&right, &center, 1);
+    Wall_ShiftBack(&left, &center, 1);
+    for (i = 0; i < WALL_PLANE_WORDS; i++)
+        row.words[i] = center.words[i] | (right.words[i] & ~sWallColumnFirst.words[i]) | (left.words[i] & ~sWallColumnLast.words[i]);
+
+    // Spread up and down: the whole row for the hammer, only the center for the pickaxe
+    Wall_ShiftForward(&down, isHammer ? &row : &center, WALL_WIDTH);
+    Wall_ShiftBack(&up, isHammer ? &row : &center, WALL_WIDTH);
+    for (i = 0; i < WALL_PLANE_WORDS; i++)
+        stencil->words[i] = row.words[i] | down.words[i] | up.words[i];
+}
+
+// Digs every cell of the stencil one layer deeper. The depth planes are added to as a ripple carry, so all
+// cells of a word step at once. Cells already cleared stay put and are dropped from the stencil, which is
+// left holding the cells that changed.
+static void Wall_Dig(struct WallPlane *stencil)
+{
+    struct WallPlane cleared;
+    u32 i;
+    u32 j;
+    u32 carry;
+    u32 next;
+
+    Wall_GetCleared(&cleared);
+    for (i = 0; i < WALL_PLANE_WORDS; i++)
+    {
+        carry = stencil->words[i] & ~cleared.words[i];
+        stencil->words[i] = carry;
+        for (j = 0; j < 3; j++)
+        {
+            next = sExcavationUiState->layer[j].words[i] & carry;
+            sExcavationUiState->layer[j].words[i] ^= carry;
+            carry = next;
+        }
+    }
+}
+
+// The minigame's own xorshift32 generator. A whole wall comes out of the one seed Excavation_Init starts it
+// from, so a wall can be replayed from its seed (see EXCAVATION_FIXED_SEED).
+// The seed is multiplied by an odd constant first, so small seeds (like a layout's 16-bit terrain seed) still
+// start from well mixed states. Only a zero seed can give the zero state xorshift would stick at.
+static void ExcavationRng_Seed(u32 *state, u32 seed)
+{
+    *state = seed * 0x9E3779B9;
+    if (*state == 0)
+        *state = 0x9E3779B9;
+}
+
+static u32 ExcavationRng_Next(u32 *state)
+{
+    u32 x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+// It will create a random number between 0 and amount-1 (amount up to 0x10000).
+// The top 16 bits are scaled by amount instead of taking a remainder, so it's one multiply and no division.
+static u32 random(u32 amount)
+{
+    return ((ExcavationRng_Next(&sExcavationUiState->rngState) >> 16) * amount) >> 16;
+}
+
+// Hit animation: the wall shakes while the hit effect flashes and the tool swings.
+// Each step is held for HIT_ANIM_STEP_FRAMES, the tool stays up HIT_ANIM_TOOL_FRAMES longer.
+#define HIT_ANIM_STEP_FRAMES 2
+#define HIT_ANIM_TOOL_FRAMES 4
+
+#define tStep           data[0]
+#define tTimer          data[1]
+#define tEffectSpriteId data[2]
+#define tToolSpriteId   data[3]
+
+static void Task_ExcavationHitAnim(u8 taskId)
+{
+    s16 *data = gTasks[taskId].data;
+    struct Sprite *effect = &gSprites[tEffectSpriteId];
+    struct Sprite *tool = &gSprites[tToolSpriteId];
+
+    if (tTimer != 0)
+    {
+        tTimer--;
+        return;
+    }
+    tTimer = HIT_ANIM_STEP_FRAMES - 1;
+
+    switch (tStep)
+    {
+    case 0:
+        SetGpuReg(REG_OFFSET_BG3HOFS, 1);
+        SetGpuReg(REG_OFFSET_BG2HOFS, 1);
+        break;
+    case 1:
+        SetGpuReg(REG_OFFSET_BG3VOFS, 1);
+        SetGpuReg(REG_OFFSET_BG2VOFS, 1);
+        effect->invisible = 1;
+        tool->invisible = 1;
+        break;
+    case 2:
+        SetGpuReg(REG_OFFSET_BG3HOFS, -1);
+        SetGpuReg(REG_OFFSET_BG2HOFS, -1);
+        effect->invisible = 0;
+        tool->invisible = 0;
+        break;
+    case 3:
+        SetGpuReg(REG_OFFSET_BG3VOFS, -1);
+        SetGpuReg(REG_OFFSET_BG2VOFS, -1);
+        effect->invisible = 1;
+        break;
+    case 4:
+        SetGpuReg(REG_OFFSET_BG3HOFS, 1);
+        SetGpuReg(REG_OFFSET_BG2HOFS, 1);
+        effect->invisible = 0;
+        StartSpriteAnim(tool, 1);
+        tool->x += 7;
+        break;
+    case 5:
+        SetGpuReg(REG_OFFSET_BG3VOFS, 1);
+        SetGpuReg(REG_OFFSET_BG2VOFS, 1);
+        effect->invisible = 1;
+        break;
+    case 6:
+        SetGpuReg(REG_OFFSET_BG3HOFS, -1);
+        SetGpuReg(REG_OFFSET_BG2HOFS, -1);
+        effect->invisible = 0;
+        tool->invisible = 1;
+        break;
+    case 7:
+        SetGpuReg(REG_OFFSET_BG3VOFS, -1);
+        SetGpuReg(REG_OFFSET_BG2VOFS, -1);
+        effect->invisible = 1;
+        tool->invisible = 0;
+        break;
+    case 8:
+        // Back to default offset
+        SetGpuReg(REG_OFFSET_BG3VOFS, 0);
+        SetGpuReg(REG_OFFSET_BG3HOFS, 0);
+        SetGpuReg(REG_OFFSET_BG2HOFS, 0);
+        SetGpuReg(REG_OFFSET_BG2VOFS, 0);
+        gSprites[sExcavationUiState->cursorSpriteIndex].invisible = 0;
+        DestroySprite(effect);
+        tTimer = HIT_ANIM_TOOL_FRAMES - 1;
+        break;
+    default:
+        DestroySprite(tool);
+        DestroyTask(taskId);
+        return;
+    }
+    tStep++;
+}
+
+static void UiShake(void)
+{
+    u8 taskId = CreateTask(Task_ExcavationHitAnim, 1);
+    s16 *data = gTasks[taskId].data;
+    s16 x = sExcavationUiState->cursorX * 16;
+    s16 y = sExcavationUiState->cursorY * 16;
 
     if (sExcavationUiState->mode == 1)
     {
-        i = CreateSprite(&gSpriteHitEffectHammer, (sExcavationUiState->cursorX * 16) + 8, (sExcavationUiState->cursorY * 16) + 8, 0);
-        i2 = CreateSprite(&gSpriteHitHammer, (sExcavationUiState->cursorX * 16) + 24, sExcavationUiState->cursorY * 16, 0);
+        tEffectSpriteId = CreateSprite(&gSpriteHitEffectHammer, x + 8, y + 8, 0);
+        tToolSpriteId = CreateSprite(&gSpriteHitHammer, x + 24, y, 0);
     }
     else
     {
-        i = CreateSprite(&gSpriteHitEffectPickaxe, (sExcavationUiState->cursorX * 16) + 8, (sExcavationUiState->cursorY * 16) + 8, 0);
-        i2 = CreateSprite(&gSpriteHitPickaxe, (sExcavationUiState->cursorX * 16) + 24, sExcavationUiState->cursorY * 16, 0);
+        tEffectSpriteId = CreateSprite(&gSpriteHitEffectPickaxe, x + 8, y + 8, 0);
+        tToolSpriteId = CreateSprite(&gSpriteHitPickaxe, x + 24, y, 0);
     }
     MakeCursorInvisible();
-    SetGpuReg(REG_OFFSET_BG3HOFS, 1);
-    SetGpuReg(REG_OFFSET_BG2HOFS, 1);
-    delay(3000);
-    BuildOamBuffer();
-    SetGpuReg(REG_OFFSET_BG3VOFS, 1);
-    SetGpuReg(REG_OFFSET_BG2VOFS, 1);
-    gSprites[i].invisible = 1;
-    gSprites[i2].invisible = 1;
-    BuildOamBuffer();
-    delay(3000);
-    SetGpuReg(REG_OFFSET_BG3HOFS, -1);
-    SetGpuReg(REG_OFFSET_BG2HOFS, -1);
-    gSprites[i].invisible = 0;
-    gSprites[i2].invisible = 0;
-    BuildOamBuffer();
-    delay(3000);
-    SetGpuReg(REG_OFFSET_BG3VOFS, -1);
-    SetGpuReg(REG_OFFSET_BG2VOFS, -1);
-    gSprites[i].invisible = 1;
-    BuildOamBuffer();
-    delay(3000);
-    SetGpuReg(REG_OFFSET_BG3HOFS, 1);
-    SetGpuReg(REG_OFFSET_BG2HOFS, 1);
-    gSprites[i].invisible = 0;
-    StartSpriteAnim(&gSprites[i2], 1);
-    gSprites[i2].x += 7;
-    AnimateSprites();
-    BuildOamBuffer();
-    delay(3000);
-    SetGpuReg(REG_OFFSET_BG3VOFS, 1);
-    SetGpuReg(REG_OFFSET_BG2VOFS, 1);
-    gSprites[i].invisible = 1;
-    BuildOamBuffer();
-    delay(3000);
-    SetGpuReg(REG_OFFSET_BG3HOFS, -1);
-    SetGpuReg(REG_OFFSET_BG2HOFS, -1);
-    gSprites[i].invisible = 0;
-    gSprites[i2].invisible = 1;
-    BuildOamBuffer();
-    delay(3000);
-    SetGpuReg(REG_OFFSET_BG3VOFS, -1);
-    SetGpuReg(REG_OFFSET_BG2VOFS, -1);
-    gSprites[i].invisible = 1;
-    gSprites[i2].invisible = 0;
-    BuildOamBuffer();
-    delay(3000);
+}
 
-    // Back to default offset
-    SetGpuReg(REG_OFFSET_BG3VOFS, 0);
-    SetGpuReg(REG_OFFSET_BG3HOFS, 0);
-    SetGpuReg(REG_OFFSET_BG2HOFS, 0);
-    SetGpuReg(REG_OFFSET_BG2VOFS, 0);
-    gSprites[sExcavationUiState->cursorSpriteIndex].invisible = 0;
-    DestroySprite(&gSprites[i]);
-    delay(8000);
-    DestroySprite(&gSprites[i2]);
+#undef tStep
+#undef tTimer
+#undef tEffectSpriteId
+#undef tToolSpriteId
+
+static bool32 IsHitAnimRunning(void)
+{
+    return FuncIsActiveTask(Task_ExcavationHitAnim);
 }
 
 void Excavation_ItemUseCB(void)
@@ -1036,7 +1090,9 @@ void ResetAllBgsCoordinates(void)
 
 static void Excavation_Init(MainCallback callback)
 {
-    u8 rnd = Random();
+#ifdef EXCAVATION_RUNTIME_WALLS
+    u32 rnd;
+#endif
     sExcavationUiState = Malloc(sizeof(struct ExcavationState));
 
     if (sExcavationUiState == NULL)
@@ -1049,7 +1105,18 @@ static void Excavation_Init(MainCallback callback)
     sExcavationUiState->loadGameState = 0;
     sExcavationUiState->crackCount = 0;
     sExcavationUiState->crackPos = 0;
+    sExcavationUiState->foundPaletteMask = 0;
+    CpuFill32(0, sExcavationUiState->bg2DirtyColumns, sizeof(sExcavationUiState->bg2DirtyColumns));
+
+#ifdef EXCAVATION_FIXED_SEED
+    sExcavationUiState->seed = EXCAVATION_FIXED_SEED;
+#else
+    // The session's only draw from Random(): the whole wall comes from this seed
+    sExcavationUiState->seed = Random32();
+#endif
+    ExcavationRng_Seed(&sExcavationUiState->rngState, sExcavationUiState->seed);
 
+#ifdef EXCAVATION_RUNTIME_WALLS
     // Always zone1 and zone4 have an item
     // TODO: Will change that because the user can always assume there is an item in those zones, 100 percently
     sExcavationUiState->state_item1 = SELECTED;
@@ -1059,7 +1126,7 @@ static void Excavation_Init(MainCallback callback)
     sExcavationUiState->state_stone1 = SELECTED;
     sExcavationUiState->state_stone2 = SELECTED;
 
-    // TODO: Change this randomness by using my function `random(u32 amount);`
+    rnd = random(256);
     if (rnd < 85)
     {
         rnd = 0;
@@ -1088,6 +1155,13 @@ static void Excavation_Init(MainCallback callback)
         sExcavationUiState->state_item2 = SELECTED;
         break;
     }
+    sExcavationUiState->terrainSeed = ExcavationRng_Next(&sExcavationUiState->rngState);
+#else
+    // The wall is prebuilt (see scripts/wall_layouts.py), down to its terrain
+    sExcavationUiState->layout = &sWallLayouts[random(WALL_LAYOUT_COUNT)];
+    sExcavationUiState->terrainSeed = sExcavationUiState->layout->terrainSeed;
+#endif
+
     SetMainCallback2(Excavation_SetupCB);
 }
 
@@ -1271,17 +1345,12 @@ static void Excavation_MainCB(void)
 
 static void Excavation_VBlankCB(void)
 {
-    // I discovered that the VBlankCB is actually ran every VBlank. There's no function that can halt it just because of a huge loop or smth
-    // However I discovered that the MainCB can be halted! And that's actually the case. UiShake() delays with huge loops to make the shake
-    // effect visible! Because of this, other tasks cannot run (or other functions) in the same time as UiShake is ran. This makes the fade/flash
-    // effect on the items which got dug up, delay by a few `ms`! Because Vblank cannot be halted, we just do the checking, each vblank + there's no lag
-    // because of this!
-    Excavation_CheckItemFound();
     UpdatePaletteFade();
 
     LoadOam();
     ProcessSpriteCopyRequests();
     TransferPlttBuffer();
+    Excavation_CopyDirtyTilemapRows();
 }
 
 static void Excavation_FadeAndBail(void)
@@ -1323,7 +1392,7 @@ static bool8 Excavation_LoadBgGraphics(void)
         LoadPalette(sUiPalette, BG_PLTT_ID(0), PLTT_SIZE_4BPP);
         sExcavationUiState->loadGameState++;
     case 3:
-        Excavation_DrawRandomTerrain();
+        Excavation_DrawRandomTerrain(sExcavationUiState->terrainSeed);
         sExcavationUiState->loadGameState++;
     default:
         sExcavationUiState->loadGameState = STATE_GAME_START;
@@ -1336,85 +1405,42 @@ static void ClearItemMap(void)
 {
     u8 i;
 
-    for (i = 0; i < 96; i++)
+    for (i = 0; i < MAX_NUM_BURIED_ITEMS; i++)
     {
-        sExcavationUiState->itemMap[i] = ITEM_TILE_NONE;
+        Wall_Clear(&sExcavationUiState->itemPlane[i]);
     }
+    Wall_Clear(&sExcavationUiState->stonePlane);
 }
 
-#define RARITY_COMMON 0
-#define RARITY_UNCOMMON 1
-#define RARITY_RARE 2
-
-struct ItemRarity
+#ifdef EXCAVATION_RUNTIME_WALLS
+// Draws a buried item with the odds in excavation_loot.txt, from the alias table scripts/loot_table.py builds out of it.
+// The top half of one draw picks a column, the bottom half decides between the column's item and its alias.
+static u8 GetRandomItemId(void)
 {
-    u8 itemId;
-    u8 rarity;
-};
+    u32 rnd = ExcavationRng_Next(&sExcavationUiState->rngState);
+    const struct LootEntry *entry = &sLootTable[((rnd >> 16) * LOOT_TABLE_SIZE) >> 16];
 
-static const struct ItemRarity ItemRarityTable_Common[] = {
-    {ITEMID_HEART_SCALE, RARITY_COMMON},
-    {ITEMID_RED_SHARD, RARITY_COMMON},
-    {ITEMID_BLUE_SHARD, RARITY_COMMON},
-};
-
-static const struct ItemRarity ItemRarityTable_Uncommon[] = {
-    {ITEMID_IRON_BALL, RARITY_RARE},
-    {ITEMID_HARD_STONE, RARITY_RARE},
-    {ITEMID_REVIVE, RARITY_RARE},
-    {ITEMID_EVER_STONE, RARITY_RARE},
-};
+    if ((rnd & 0xFFFF) < entry->threshold)
+        return entry->itemId;
+    return entry->aliasItemId;
+}
 
-static const struct ItemRarity ItemRarityTable_Rare[] = {
-    {ITEMID_STAR_PIECE, RARITY_RARE},
-    {ITEMID_DAMP_ROCK, RARITY_RARE},
-    {ITEMID_REVIVE_MAX, RARITY_RARE},
+static const u8 sStoneIds[] = {
+    ID_STONE_1x4,
+    ID_STONE_4x1,
+    ID_STONE_2x4,
+    ID_STONE_4x2,
+    ID_STONE_2x2,
+    ID_STONE_3x3,
 };
+#endif
 
-static u8 GetRandomItemId()
-{
-    u32 rarity;
-    u32 index;
-    u32 rnd = random(7);
-
-    if (rnd < 4)
-    {
-        rarity = RARITY_COMMON;
-    }
-    else if (rnd < 6)
-    {
-        rarity = RARITY_UNCOMMON;
-    }
-    else if (rnd == 6)
-    {
-        rarity = RARITY_RARE;
-    }
-
-    switch (rarity)
-    {
-    case RARITY_COMMON:
-        index = random(3);
-        return ItemRarityTable_Common[index].itemId;
-        break;
-    case RARITY_UNCOMMON:
-        index = random(4);
-        return ItemRarityTable_Uncommon[index].itemId;
-        break;
-    case RARITY_RARE:
-        index = random(3);
-        return ItemRarityTable_Rare[index].itemId;
-        break;
-    }
-
-    // This won't ever happen.
-    return 0;
-}
-
-static void Excavation_LoadSpriteGraphics(void)
+static void Excavation_LoadSpriteGraphics(void)
 {
+#ifdef EXCAVATION_RUNTIME_WALLS
     u8 i;
     u8 itemId1, itemId2, itemId3, itemId4;
-    u16 rnd;
+#endif
     LoadSpritePalette(sSpritePal_Cursor);
     LoadCompressedSpriteSheet(sSpriteSheet_Cursor);
 
@@ -1423,20 +1449,19 @@ static void Excavation_LoadSpriteGraphics(void)
 
     ClearItemMap();
 
+#ifdef EXCAVATION_RUNTIME_WALLS
     // ITEMS
     if (sExcavationUiState->state_item1 == SELECTED)
     {
         itemId1 = GetRandomItemId();
         SetBuriedItemsId(0, itemId1);
         DoDrawRandomItem(1, itemId1);
-        sExcavationUiState->Item1_TilesToDigUp = ExcavationUtil_GetTotalTileAmount(itemId1);
     }
     if (sExcavationUiState->state_item2 == SELECTED)
     {
         itemId2 = GetRandomItemId();
         SetBuriedItemsId(1, itemId2);
         DoDrawRandomItem(2, itemId2);
-        sExcavationUiState->Item2_TilesToDigUp = ExcavationUtil_GetTotalTileAmount(itemId2);
     }
     else
     {
@@ -1447,7 +1472,6 @@ static void Excavation_LoadSpriteGraphics(void)
         itemId3 = GetRandomItemId();
         SetBuriedItemsId(2, itemId3);
         DoDrawRandomItem(3, itemId3);
-        sExcavationUiState->Item3_TilesToDigUp = ExcavationUtil_GetTotalTileAmount(itemId3);
     }
     else
     {
@@ -1458,39 +1482,15 @@ static void Excavation_LoadSpriteGraphics(void)
         itemId4 = GetRandomItemId();
         SetBuriedItemsId(3, itemId4);
         DoDrawRandomItem(4, itemId4);
-        sExcavationUiState->Item4_TilesToDigUp = ExcavationUtil_GetTotalTileAmount(itemId4);
     }
 
-    // TODO: Change this randomness by using my new `random(u32 amount);` function!
     for (i = 0; i < 2; i++)
     {
-        rnd = Random();
-
-        if (rnd < 10922)
-        {
-            DoDrawRandomStone(ID_STONE_1x4);
-        }
-        else if (rnd < 21844)
-        {
-            DoDrawRandomStone(ID_STONE_4x1);
-        }
-        else if (rnd < 32766)
-        {
-            DoDrawRandomStone(ID_STONE_2x4);
-        }
-        else if (rnd < 43688)
-        {
-            DoDrawRandomStone(ID_STONE_4x2);
-        }
-        else if (rnd < 54610)
-        {
-            DoDrawRandomStone(ID_STONE_2x2);
-        }
-        else if (rnd < 65535)
-        {
-            DoDrawRandomStone(ID_STONE_3x3);
-        }
+        DoDrawRandomStone(sStoneIds[random(ARRAY_COUNT(sStoneIds))]);
     }
+#else
+    Excavation_LoadWallLayout(sExcavationUiState->layout);
+#endif
 
     sExcavationUiState->cursorSpriteIndex = CreateSprite(&gSpriteCursor, 8, 40, 0);
     sExcavationUiState->cursorX = 0;
@@ -1522,22 +1522,17 @@ static void Task_ExcavationWaitFadeIn(u8 taskId)
 
 static void Task_ExcavationMainInput(u8 taskId)
 {
-
-    // Because the UiShake function does manual delays with for loops, we have to imediatly call the update functions for sprites and the schedule
-    // functions for bgs. Otherwise we would notice the changes very late
-    if (gMain.newKeys & A_BUTTON /*&& sExcavationUiState->crackPos < 8 */)
+    // The cursor can move while a hit is animating, but the next hit (and the end of the game) waits for it
+    if (gMain.newKeys & A_BUTTON && !IsHitAnimRunning())
     {
         if (sExcavationUiState->mode == RED_BUTTON)
             PlaySE(SE_BALLOON_BLUE);
         else
             PlaySE(SE_BALLOON_RED);
         Excavation_UpdateTerrain();
+        Excavation_FlashFoundItems();
         Excavation_UpdateCracks();
-        ScheduleBgCopyTilemapToVram(2);
-        DoScheduledBgTilemapCopiesToVram();
-        BuildOamBuffer();
         UiShake();
-        // delay(8000);
     }
 
     else if (gMain.newAndRepeatedKeys & DPAD_LEFT && CURSOR_SPRITE.x > 8)
@@ -1574,6 +1569,9 @@ static void Task_ExcavationMainInput(u8 taskId)
         sExcavationUiState->mode = BLUE_BUTTON;
     }
 
+    if (IsHitAnimRunning())
+        return;
+
     if (AreAllItemsFound())
         EndMining(taskId);
 
@@ -1583,339 +1581,116 @@ static void Task_ExcavationMainInput(u8 taskId)
 
 #define TILE_POS(x, y) (32 * (y) + (x))
 
-// Overwrites specific tile in the tilemap of a background!!!
-// Credits to Sbird (Karathan) for helping me with the tile override!
-static void OverwriteTileDataInTilemapBuffer(u8 tile, u8 x, u8 y, u16 *tilemapBuf, u8 pal)
+// Called in VBlank. Copies each BG2 row that changed from its first to its last changed tile,
+// instead of the whole tilemap: a hit and its crack touch a few dozen tiles.
+static void Excavation_CopyDirtyTilemapRows(void)
 {
-    tilemapBuf[TILE_POS(x, y)] = tile | (pal << 12);
-}
+    const u16 *src = GetBgTilemapBuffer(2);
+    u16 *dest = (u16 *)BG_SCREEN_ADDR(GetBgAttribute(2, BG_ATTR_MAPBASEINDEX));
+    u32 y;
+    u32 columns;
+    u32 left;
+    u32 right;
 
-// DO NOT TOUCH ANY OF THE CRACK UPDATE FUNCTIONS!!!!! GENERATION IS TOO COMPLICATED TO GET FIXED! (most likely will forget everything lmao (thats why)! )!
-//
-// Each function represent one frame of a crack, but why are there two offset vars?????
-// Well there's `ofs` for telling how much to the left the next crack goes, (cracks are splite up by seven of these 32x32 `sprites`) (Cracks start at the end, so 23 is the first tile.);
-//
-// `ofs2` tells how far the tile should move to the right side. Thats because the cracks dont really line up each other.
-// So you cant put one 32x32 `sprite` (calling them sprites) right next to another 32x32 `sprite`. To align the next `sprite` so it looks right, we have to offset the next `sprite` by 8 pixels or 1 tile.
-//
-// You are still confused? Im sorry I cant help you, after one week, I will also have problems understanding that again.
-//
-// NOTE TO MY FUTURE SELF: The crack updating
-static void Crack_DrawCrack_0(u8 ofs, u8 ofs2, u16 *ptr)
-{
-    OverwriteTileDataInTilemapBuffer(0x07, 21 - ofs * 4 + ofs2, 1, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x08, 22 - ofs * 4 + ofs2, 1, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x09, 23 - ofs * 4 + ofs2, 1, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x0E, 22 - ofs * 4 + ofs2, 2, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x0F, 23 - ofs * 4 + ofs2, 2, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x14, 23 - ofs * 4 + ofs2, 3, ptr, 0x01);
-}
-
-static void Crack_DrawCrack_1(u8 ofs, u8 ofs2, u16 *ptr)
-{
-    OverwriteTileDataInTilemapBuffer(0x17, 21 - ofs * 4 + ofs2, 0, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x18, 22 - ofs * 4 + ofs2, 0, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x1B, 21 - ofs * 4 + ofs2, 1, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x1C, 22 - ofs * 4 + ofs2, 1, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x1D, 23 - ofs * 4 + ofs2, 1, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x22, 22 - ofs * 4 + ofs2, 2, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x23, 23 - ofs * 4 + ofs2, 2, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x26, 23 - ofs * 4 + ofs2, 3, ptr, 0x01);
-}
-
-static void Crack_DrawCrack_2(u8 ofs, u8 ofs2, u16 *ptr)
-{
-    OverwriteTileDataInTilemapBuffer(0x27, 20 - ofs * 4 + ofs2, 0, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x28, 21 - ofs * 4 + ofs2, 0, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x29, 22 - ofs * 4 + ofs2, 0, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x2A, 20 - ofs * 4 + ofs2, 1, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x2B, 21 - ofs * 4 + ofs2, 1, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x2C, 22 - ofs * 4 + ofs2, 1, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x2D, 23 - ofs * 4 + ofs2, 1, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x2E, 21 - ofs * 4 + ofs2, 2, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x2F, 22 - ofs * 4 + ofs2, 2, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x30, 23 - ofs * 4 + ofs2, 2, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x26, 23 - ofs * 4 + ofs2, 3, ptr, 0x01);
-}
-
-static void Crack_DrawCrack_3(u8 ofs, u8 ofs2, u16 *ptr)
-{
-    // Clean up 0x27, 0x28 and 0x29 from Crack_DrawCrack_2
-    OverwriteTileDataInTilemapBuffer(0x00, 20 - ofs * 4 + ofs2, 0, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x00, 21 - ofs * 4 + ofs2, 0, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x00, 22 - ofs * 4 + ofs2, 0, ptr, 0x01);
-
-    OverwriteTileDataInTilemapBuffer(0x31, 22 - ofs * 4 + ofs2, 0, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x32, 20 - ofs * 4 + ofs2, 1, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x33, 21 - ofs * 4 + ofs2, 1, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x34, 22 - ofs * 4 + ofs2, 1, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x2D, 23 - ofs * 4 + ofs2, 1, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x35, 20 - ofs * 4 + ofs2, 2, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x36, 21 - ofs * 4 + ofs2, 2, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x37, 22 - ofs * 4 + ofs2, 2, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x30, 23 - ofs * 4 + ofs2, 2, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x26, 23 - ofs * 4 + ofs2, 3, ptr, 0x01);
-}
-
-static void Crack_DrawCrack_4(u8 ofs, u8 ofs2, u16 *ptr)
-{
-    // The same clean up as Crack_DrawCrack_3 but only used when the hammer is used
-    OverwriteTileDataInTilemapBuffer(0x00, 20 - ofs * 4 + ofs2, 0, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x00, 21 - ofs * 4 + ofs2, 0, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x00, 22 - ofs * 4 + ofs2, 0, ptr, 0x01);
-
-    OverwriteTileDataInTilemapBuffer(0x38, 22 - ofs * 4 + ofs2, 0, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x39, 20 - ofs * 4 + ofs2, 1, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x3A, 21 - ofs * 4 + ofs2, 1, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x3B, 22 - ofs * 4 + ofs2, 1, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x2D, 23 - ofs * 4 + ofs2, 1, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x3C, 19 - ofs * 4 + ofs2, 2, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x3D, 20 - ofs * 4 + ofs2, 2, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x3E, 21 - ofs * 4 + ofs2, 2, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x3F, 22 - ofs * 4 + ofs2, 2, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x30, 23 - ofs * 4 + ofs2, 2, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x40, 19 - ofs * 4 + ofs2, 3, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x41, 20 - ofs * 4 + ofs2, 3, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x42, 21 - ofs * 4 + ofs2, 3, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x26, 23 - ofs * 4 + ofs2, 3, ptr, 0x01);
-}
-
-static void Crack_DrawCrack_5(u8 ofs, u8 ofs2, u16 *ptr)
-{
-    OverwriteTileDataInTilemapBuffer(0x43, 20 - ofs * 4 + ofs2, 1, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x44, 21 - ofs * 4 + ofs2, 1, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x3B, 22 - ofs * 4 + ofs2, 1, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x2D, 23 - ofs * 4 + ofs2, 1, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x45, 19 - ofs * 4 + ofs2, 2, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x46, 20 - ofs * 4 + ofs2, 2, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x47, 21 - ofs * 4 + ofs2, 2, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x3F, 22 - ofs * 4 + ofs2, 2, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x30, 23 - ofs * 4 + ofs2, 2, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x48, 19 - ofs * 4 + ofs2, 3, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x49, 20 - ofs * 4 + ofs2, 3, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x4A, 21 - ofs * 4 + ofs2, 3, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x26, 23 - ofs * 4 + ofs2, 3, ptr, 0x01);
-}
-
-static void Crack_DrawCrack_6(u8 ofs, u8 ofs2, u16 *ptr)
-{
-    // Clean up 0x48 and 0x49 from Crack_DrawCrack_5
-    OverwriteTileDataInTilemapBuffer(0x00, 19 - ofs * 4 + ofs2, 3, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x00, 20 - ofs * 4 + ofs2, 3, ptr, 0x01);
-
-    OverwriteTileDataInTilemapBuffer(0x07, 18 - ofs * 4 + ofs2, 1, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x08, 19 - ofs * 4 + ofs2, 1, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x09, 20 - ofs * 4 + ofs2, 1, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x44, 21 - ofs * 4 + ofs2, 1, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x3B, 22 - ofs * 4 + ofs2, 1, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x2D, 23 - ofs * 4 + ofs2, 1, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x0E, 19 - ofs * 4 + ofs2, 2, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x0F, 20 - ofs * 4 + ofs2, 2, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x4B, 21 - ofs * 4 + ofs2, 2, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x3F, 22 - ofs * 4 + ofs2, 2, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x30, 23 - ofs * 4 + ofs2, 2, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x14, 20 - ofs * 4 + ofs2, 3, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x4A, 21 - ofs * 4 + ofs2, 3, ptr, 0x01);
-    OverwriteTileDataInTilemapBuffer(0x26, 23 - ofs * 4 + ofs2, 3, ptr, 0x01);
-}
-
-// DO NOT TOUCH ANY OF THE CRACK UPDATE FUNCTIONS!!!!! GENERATION IS TOO COMPLICATED TO GET FIXED!
-static void Crack_UpdateCracksRelativeToCrackPos(u8 offsetIn8, u8 ofs2, u16 *ptr)
-{
-    switch (sExcavationUiState->crackCount)
+    for (y = 0; y < ARRAY_COUNT(sExcavationUiState->bg2DirtyColumns); y++)
     {
-    case 0:
-        Crack_DrawCrack_0(offsetIn8, ofs2, ptr);
-        if (sExcavationUiState->mode == 1)
-        {
-            sExcavationUiState->crackCount++;
-        }
-        sExcavationUiState->crackCount++;
-        break;
-    case 1:
-        Crack_DrawCrack_1(offsetIn8, ofs2, ptr);
-        if (sExcavationUiState->mode == 1)
-        {
-            sExcavationUiState->crackCount++;
-        }
-        sExcavationUiState->crackCount++;
-        break;
-    case 2:
-        Crack_DrawCrack_2(offsetIn8, ofs2, ptr);
-        if (sExcavationUiState->mode == 1)
-        {
-            sExcavationUiState->crackCount++;
-        }
-        sExcavationUiState->crackCount++;
-        break;
-    case 3:
-        Crack_DrawCrack_3(offsetIn8, ofs2, ptr);
-        if (sExcavationUiState->mode == 1)
-        {
-            sExcavationUiState->crackCount++;
-        }
-        sExcavationUiState->crackCount++;
-        break;
-    case 4:
-        Crack_DrawCrack_4(offsetIn8, ofs2, ptr);
-        if (sExcavationUiState->mode == 1)
-        {
-            sExcavationUiState->crackCount++;
-        }
-        sExcavationUiState->crackCount++;
-        break;
-    case 5:
-        Crack_DrawCrack_5(offsetIn8, ofs2, ptr);
-        sExcavationUiState->crackCount++;
-        break;
-    case 6:
-        Crack_DrawCrack_6(offsetIn8, ofs2, ptr);
-        sExcavationUiState->crackCount = 1;
-        sExcavationUiState->crackPos++;
-        break;
+        columns = sExcavationUiState->bg2DirtyColumns[y];
+        if (columns == 0)
+            continue;
+        sExcavationUiState->bg2DirtyColumns[y] = 0;
+
+        for (left = 0; !(columns & (1u << left)); left++)
+            ;
+        for (right = 31; !(columns & (1u << right)); right--)
+            ;
+        DmaCopy16(3, &src[TILE_POS(left, y)], &dest[TILE_POS(left, y)], (right - left + 1) * sizeof(u16));
     }
 }
 
-// DO NOT TOUCH ANY OF THE CRACK UPDATE FUNCTIONS!!!!! GENERATION IS TOO COMPLICATED TO GET FIXED!
-static void Excavation_UpdateCracks(void)
+// Copies a strip of the crack into the top rows of BG2, row by row, and marks it for the next upload
+static void Crack_DrawStrip(const struct CrackStrip *strip)
 {
-    u16 *ptr = GetBgTilemapBuffer(2);
-    switch (sExcavationUiState->crackPos)
+    u16 *tilemap = GetBgTilemapBuffer(2);
+    u32 y;
+
+    for (y = 0; y < CRACK_STRIP_HEIGHT; y++)
     {
-    case 0:
-        Crack_UpdateCracksRelativeToCrackPos(0, 0, ptr);
-        break;
-    case 1:
-        Crack_UpdateCracksRelativeToCrackPos(1, 1, ptr);
-        break;
-    case 2:
-        Crack_UpdateCracksRelativeToCrackPos(2, 2, ptr);
-        break;
-    case 3:
-        Crack_UpdateCracksRelativeToCrackPos(3, 3, ptr);
-        break;
-    case 4:
-        Crack_UpdateCracksRelativeToCrackPos(4, 4, ptr);
-        break;
-    case 5:
-        Crack_UpdateCracksRelativeToCrackPos(5, 5, ptr);
-        break;
-    case 6:
-        Crack_UpdateCracksRelativeToCrackPos(6, 6, ptr);
-        break;
-    case 7:
-        Crack_UpdateCracksRelativeToCrackPos(7, 7, ptr);
-        break;
+        CpuCopy16(strip->tiles[y], &tilemap[TILE_POS(strip->left, y)], strip->width * sizeof(u16));
+        sExcavationUiState->bg2DirtyColumns[y] |= ((1u << strip->width) - 1) << strip->left;
     }
 }
 
-// Draws a tile layer (of the terrain) to the screen.
-// This function is used to make a random sequence of terrain tiles.
-//
-// In the switch statement, for example case 0 and case 1 do the same thing. Thats because the layer is a 3 bit integer (2 * 2 * 2 possible nums) and I want multiple probabilies for
-// other tiles as well. Thats why case 0 and case 1 do the same thing, to increase the probabily of drawing layer_tile 0 to the screen.
-static void Terrain_DrawLayerTileToScreen(u8 x, u8 y, u8 layer, u16 *ptr)
+// The crack runs in segments of CRACK_FRAME_COUNT frames each (see graphics/excavation/cracks.txt).
+// Every frame is precomputed by scripts/crack_strips.py as the whole segment after it, so a hammer
+// hit that skips a frame still leaves the crack looking as if it had been drawn.
+static void Excavation_UpdateCracks(void)
 {
-    u8 tileX = x;
-    u8 tileY = y;
+    if (sExcavationUiState->crackPos >= ARRAY_COUNT(sCrackStrips))
+        return;
 
-    // Idk why tf I am doing the checking
-    // TODO: Change this \/
-    if (x == 0)
-    {
-        tileX = 0;
-    }
-    else
-    {
-        tileX = x * 2;
-    }
+    Crack_DrawStrip(&sCrackStrips[sExcavationUiState->crackPos][sExcavationUiState->crackCount]);
 
-    if (y == 0)
+    if (sExcavationUiState->crackCount == CRACK_FRAME_COUNT - 1)
     {
-        tileY = 0;
+        // Frame 0 only starts the first segment, the next ones go on from the last frame of the one before
+        sExcavationUiState->crackCount = 1;
+        sExcavationUiState->crackPos++;
     }
     else
     {
-        tileY = y * 2;
+        // The hammer cracks the wall twice as fast, but always stops on the last frame of a segment
+        sExcavationUiState->crackCount++;
+        if (sExcavationUiState->mode == RED_BUTTON && sExcavationUiState->crackCount < CRACK_FRAME_COUNT - 1)
+            sExcavationUiState->crackCount++;
     }
+}
 
-    switch (layer)
-    {
-        // layer 0 and 1 - tile: 0
-    case 0:
-        OverwriteTileDataInTilemapBuffer(0x20, tileX, tileY, ptr, 0x01);
-        OverwriteTileDataInTilemapBuffer(0x21, tileX + 1, tileY, ptr, 0x01);
-        OverwriteTileDataInTilemapBuffer(0x24, tileX, tileY + 1, ptr, 0x01);
-        OverwriteTileDataInTilemapBuffer(0x25, tileX + 1, tileY + 1, ptr, 0x01);
-        break;
-    case 1:
-        OverwriteTileDataInTilemapBuffer(0x19, tileX, tileY, ptr, 0x01);
-        OverwriteTileDataInTilemapBuffer(0x1A, tileX + 1, tileY, ptr, 0x01);
-        OverwriteTileDataInTilemapBuffer(0x1E, tileX, tileY + 1, ptr, 0x01);
-        OverwriteTileDataInTilemapBuffer(0x1F, tileX + 1, tileY + 1, ptr, 0x01);
-        break;
-    case 2:
-        OverwriteTileDataInTilemapBuffer(0x10, tileX, tileY, ptr, 0x01);
-        OverwriteTileDataInTilemapBuffer(0x11, tileX + 1, tileY, ptr, 0x01);
-        OverwriteTileDataInTilemapBuffer(0x15, tileX, tileY + 1, ptr, 0x01);
-        OverwriteTileDataInTilemapBuffer(0x16, tileX + 1, tileY + 1, ptr, 0x01);
-        break;
-    case 3:
-        OverwriteTileDataInTilemapBuffer(0x0C, tileX, tileY, ptr, 0x01);
-        OverwriteTileDataInTilemapBuffer(0x0D, tileX + 1, tileY, ptr, 0x01);
-        OverwriteTileDataInTilemapBuffer(0x12, tileX, tileY + 1, ptr, 0x01);
-        OverwriteTileDataInTilemapBuffer(0x13, tileX + 1, tileY + 1, ptr, 0x01);
-        break;
-    case 4:
-        OverwriteTileDataInTilemapBuffer(0x05, tileX, tileY, ptr, 0x01);
-        OverwriteTileDataInTilemapBuffer(0x06, tileX + 1, tileY, ptr, 0x01);
-        OverwriteTileDataInTilemapBuffer(0x0A, tileX, tileY + 1, ptr, 0x01);
-        OverwriteTileDataInTilemapBuffer(0x0B, tileX + 1, tileY + 1, ptr, 0x01);
-        break;
-    case 5:
-        OverwriteTileDataInTilemapBuffer(0x01, tileX, tileY, ptr, 0x01);
-        OverwriteTileDataInTilemapBuffer(0x02, tileX + 1, tileY, ptr, 0x01);
-        OverwriteTileDataInTilemapBuffer(0x03, tileX, tileY + 1, ptr, 0x01);
-        OverwriteTileDataInTilemapBuffer(0x04, tileX + 1, tileY + 1, ptr, 0x01);
-        break;
-    }
+// The wall starts 32px down the screen, under the cracks
+#define WALL_TILEMAP_TOP 4
+
+// Two BG2 tilemap entries side by side, the left one in the low half
+#define METATILE_ROW(left, right) ((left) | (0x01 << 12) | (((right) | (0x01 << 12)) << 16))
+
+// Tiles of the metatile each terrain layer is drawn with: its top row, then its bottom row
+static const u32 sLayerMetatiles[LAYER_CLEARED + 1][2] =
+{
+    [0] = {METATILE_ROW(0x20, 0x21), METATILE_ROW(0x24, 0x25)},
+    [1] = {METATILE_ROW(0x19, 0x1A), METATILE_ROW(0x1E, 0x1F)},
+    [2] = {METATILE_ROW(0x10, 0x11), METATILE_ROW(0x15, 0x16)},
+    [3] = {METATILE_ROW(0x0C, 0x0D), METATILE_ROW(0x12, 0x13)},
+    [4] = {METATILE_ROW(0x05, 0x06), METATILE_ROW(0x0A, 0x0B)},
+    [5] = {METATILE_ROW(0x01, 0x02), METATILE_ROW(0x03, 0x04)},
+    // Cleared, so we can take a look at Bg3 (for the item sprite)!
+    [LAYER_CLEARED] = {METATILE_ROW(0x00, 0x00), METATILE_ROW(0x00, 0x00)},
+};
+
+// Draws wall cell (x, y) at the given depth. A metatile starts on an even column,
+// so each of its rows is one aligned word of the tilemap.
+static void Terrain_DrawCell(u32 *tilemap, u32 x, u32 y, u32 layer)
+{
+    u32 row = WALL_TILEMAP_TOP + y * 2;
+
+    tilemap[TILE_POS(x * 2, row) / 2] = sLayerMetatiles[layer][0];
+    tilemap[TILE_POS(x * 2, row + 1) / 2] = sLayerMetatiles[layer][1];
+    sExcavationUiState->bg2DirtyColumns[row] |= 3u << (x * 2);
+    sExcavationUiState->bg2DirtyColumns[row + 1] |= 3u << (x * 2);
 }
 
-// Turn this into a table
-static const u16 *GetCorrectPalette(u32 TileTag)
+// Redraws the cells of the plane from their layers: the whole wall, or what a hit dug
+static void Terrain_DrawCells(const struct WallPlane *cells)
 {
-    switch (TileTag)
+    u32 *tilemap = GetBgTilemapBuffer(2);
+    u32 i;
+    u32 n;
+    u32 bits;
+
+    for (i = 0; i < WALL_PLANE_WORDS; i++)
     {
-    case TAG_ITEM_REVIVE:
-        return gItemRevivePal;
-        break;
-    case TAG_ITEM_DAMP_ROCK:
-        return gItemDampRockPal;
-        break;
-    case TAG_ITEM_HARDSTONE:
-        return gItemHardStonePal;
-        break;
-    case TAG_ITEM_RED_SHARD:
-        return gItemRedShardPal;
-        break;
-    case TAG_ITEM_IRON_BALL:
-        return gItemIronBallPal;
-        break;
-    case TAG_ITEM_BLUE_SHARD:
-        return gItemBlueShardPal;
-        break;
-    case TAG_ITEM_EVER_STONE:
-        return gItemEverStonePal;
-        break;
-    case TAG_ITEM_HEARTSCALE:
-        return gItemHeartScalePal;
-        break;
-    case TAG_ITEM_REVIVE_MAX:
-        return gItemReviveMaxPal;
-        break;
-    case TAG_ITEM_STAR_PIECE:
-        return gItemStarPiecePal;
-        break;
+        for (n = i * 32, bits = cells->words[i]; bits != 0; n++, bits >>= 1)
+        {
+            if (bits & 1)
+                Terrain_DrawCell(tilemap, n % WALL_WIDTH, n / WALL_WIDTH, Wall_GetLayer(n));
+        }
     }
 }
 
@@ -1930,21 +1705,6 @@ const struct SpriteTemplate gDummySpriteTemplate =
     .callback = SpriteCallbackDummy
 };
 
-static struct SpriteTemplate CreatePaletteAndReturnTemplate(u32 TileTag, u32 PalTag)
-{
-    struct SpritePalette TempPalette;
-    struct SpriteTemplate TempSpriteTemplate = gDummySpriteTemplate;
-
-    TempPalette.tag = PalTag;
-    TempPalette.data = GetCorrectPalette(TileTag);
-    LoadSpritePalette(&TempPalette);
-
-    TempSpriteTemplate.tileTag = TileTag;
-    TempSpriteTemplate.paletteTag = PalTag;
-    TempSpriteTemplate.oam = &gOamItem64x64;
-    return TempSpriteTemplate;
-}
-
 // These offset values are important because I dont want the sprites to be placed somewhere regarding the center and not the top left corner
 //
 // Basically what these offset do is this: (c is the center the sprite uses to navigate the position and @ is the point we want, the top left corner; for a 32x32 sprite)
@@ -1965,909 +1725,321 @@ static struct SpriteTemplate CreatePaletteAndReturnTemplate(u32 TileTag, u32 Pal
 //    | - - |--|
 //    | - - |--|
 //
+// Frames are trimmed, so the center is the frame's corner within the original 64x64 sheet plus half its size.
+// The sprite keeps a pointer to its template, so it's the frame's static one from the atlas header.
+// That template leaves the palette out, so the sprite is pointed at the palette loaded with paletteTag.
+static void CreateAtlasSprite(u32 frame, u16 paletteTag, s16 x, s16 y)
+{
+    struct SpriteSheet sheet;
+    const u8 *rect = sAtlasFrameRects[frame];
+    u8 spriteId;
+
+    sheet.data = (const u8 *)gExcavationSpritesGfx + sAtlasTileOffsets[frame] * TILE_SIZE_4BPP;
+    sheet.size = rect[2] * rect[3] / 2;
+    sheet.tag = sAtlasSpriteTemplates[frame].tileTag;
+    LoadSpriteSheet(&sheet);
 
-#define POS_OFFS_32X32 16
-#define POS_OFFS_64X64 32
+    spriteId = CreateSprite(&sAtlasSpriteTemplates[frame], x + rect[0] + rect[2] / 2, y + rect[1] + rect[3] / 2, 3);
+    gSprites[spriteId].oam.paletteNum = IndexOfSpritePaletteTag(paletteTag);
+}
 
-// TODO: Make every item have a palette, even if two items have the same palette
 static void DrawItemSprite(u8 x, u8 y, u8 itemId, u32 itemNumPalTag)
 {
-    struct SpriteTemplate gSpriteTemplate;
+    struct SpritePalette palette;
+    u32 frame;
     u8 posX = x * 16;
     u8 posY = y * 16 + 32;
-    // ExcavationItem_LoadPalette(gTestItemPal, tag);
 
-    // LoadPalette(gTestItemPal, OBJ_PLTT_ID(3), PLTT_SIZE_4BPP);
-    switch (itemId)
+    if (itemId >= ID_STONE_1x4)
     {
-    case ID_STONE_1x4:
-        LoadSpritePalette(sSpritePal_Stone1x4);
-        LoadCompressedSpriteSheet(sSpriteSheet_Stone1x4);
-        CreateSprite(&gSpriteStone1x4, posX + POS_OFFS_64X64, posY + POS_OFFS_64X64, 3);
-        break;
-    case ID_STONE_4x1:
-        LoadSpritePalette(sSpritePal_Stone4x1);
-        LoadCompressedSpriteSheet(sSpriteSheet_Stone4x1);
-        CreateSprite(&gSpriteStone4x1, posX + POS_OFFS_64X64, posY + POS_OFFS_64X64, 3);
-        break;
-    case ID_STONE_2x4:
-        LoadSpritePalette(sSpritePal_Stone2x4);
-        LoadCompressedSpriteSheet(sSpriteSheet_Stone2x4);
-        CreateSprite(&gSpriteStone2x4, posX + POS_OFFS_64X64, posY + POS_OFFS_64X64, 3);
-        break;
-    case ID_STONE_4x2:
-        LoadSpritePalette(sSpritePal_Stone4x2);
-        LoadCompressedSpriteSheet(sSpriteSheet_Stone4x2);
-        CreateSprite(&gSpriteStone4x2, posX + POS_OFFS_64X64, posY + POS_OFFS_64X64, 3);
-        break;
-    case ID_STONE_2x2:
-        LoadSpritePalette(sSpritePal_Stone2x2);
-        LoadCompressedSpriteSheet(sSpriteSheet_Stone2x2);
-        CreateSprite(&gSpriteStone2x2, posX + POS_OFFS_64X64, posY + POS_OFFS_64X64, 3);
-        break;
-    case ID_STONE_3x3:
-        LoadSpritePalette(sSpritePal_Stone3x3);
-        LoadCompressedSpriteSheet(sSpriteSheet_Stone3x3);
-        CreateSprite(&gSpriteStone3x3, posX + POS_OFFS_64X64, posY + POS_OFFS_64X64, 3);
-        break;
-    default: // If Item and not Stone
-        gSpriteTemplate = CreatePaletteAndReturnTemplate(ExcavationItemList[itemId].tag, itemNumPalTag);
-        LoadCompressedSpriteSheet(ExcavationItemList[itemId].sheet);
-        CreateSprite(&gSpriteTemplate, posX + POS_OFFS_64X64, posY + POS_OFFS_64X64, 3);
-        break;
+        // Stones never flash, so stones sharing an atlas palette share its slot too
+        frame = ExcavationStoneList[itemId].frame;
+        palette.tag = TAG_PAL_ATLAS + sAtlasPaletteIds[frame];
+    }
+    else
+    {
+        // Each buried item keeps a slot of its own, so flashing it when it's found leaves the rest alone
+        frame = ExcavationItemList[itemId].frame;
+        palette.tag = itemNumPalTag;
     }
-}
 
-// Defines && Macros
-static void SetItemState(u32 posX, u32 posY, u32 x, u32 y, u32 itemStateId)
-{
-    sExcavationUiState->itemMap[posX + x + (posY + y) * 12] = itemStateId;
+    palette.data = gExcavationSpritesPal + sAtlasPaletteIds[frame] * 16;
+    LoadSpritePalette(&palette);
+    CreateAtlasSprite(frame, palette.tag, posX, posY);
 }
 
-#define OIMD_2x2                                 \
-    SetItemState(posX, posY, 0, 0, itemStateId); \
-    SetItemState(posX, posY, 1, 0, itemStateId); \
-    SetItemState(posX, posY, 0, 1, itemStateId); \
-    SetItemState(posX, posY, 1, 1, itemStateId);
-
-#define OIMD_3x3                                     \
-    OIMD_2x2                                         \
-        SetItemState(posX, posY, 2, 0, itemStateId); \
-    SetItemState(posX, posY, 2, 1, itemStateId);     \
-    SetItemState(posX, posY, 2, 2, itemStateId);     \
-    SetItemState(posX, posY, 0, 2, itemStateId);     \
-    SetItemState(posX, posY, 1, 2, itemStateId);
-
-#define OIMD_3x3_PLUS                            \
-    SetItemState(posX, posY, 1, 1, itemStateId); \
-    SetItemState(posX, posY, 1, 0, itemStateId); \
-    SetItemState(posX, posY, 0, 1, itemStateId); \
-    SetItemState(posX, posY, 1, 2, itemStateId); \
-    SetItemState(posX, posY, 2, 1, itemStateId);
-
-static void OverwriteItemMapData(u8 posX, u8 posY, u8 itemStateId, u8 itemId)
+static void Wall_PlaceShape(struct WallPlane *plane, u32 shape, u32 anchor)
 {
-    switch (itemId)
+    struct WallPlane cells;
+    u32 i;
+
+    Wall_Clear(&cells);
+    for (i = 0; i < SHAPE_SIZE; i++)
     {
-    case ID_STONE_1x4:
-        SetItemState(posX, posY, 0, 0, itemStateId);
-        SetItemState(posX, posY, 0, 1, itemStateId);
-        SetItemState(posX, posY, 0, 2, itemStateId);
-        SetItemState(posX, posY, 0, 3, itemStateId);
-        break;
-    case ID_STONE_4x1:
-        SetItemState(posX, posY, 0, 0, itemStateId);
-        SetItemState(posX, posY, 1, 0, itemStateId);
-        SetItemState(posX, posY, 2, 0, itemStateId);
-        SetItemState(posX, posY, 3, 0, itemStateId);
-        break;
-    case ID_STONE_2x4:
-        OIMD_2x2
-            SetItemState(posX, posY, 0, 2, itemStateId);
-        SetItemState(posX, posY, 0, 3, itemStateId);
-        SetItemState(posX, posY, 1, 2, itemStateId);
-        SetItemState(posX, posY, 1, 3, itemStateId);
-        break;
-    case ID_STONE_4x2:
-        OIMD_2x2
-            SetItemState(posX, posY, 2, 0, itemStateId);
-        SetItemState(posX, posY, 3, 0, itemStateId);
-        SetItemState(posX, posY, 2, 1, itemStateId);
-        SetItemState(posX, posY, 3, 1, itemStateId);
-        break;
-    case ID_STONE_2x2:
-        OIMD_2x2 break;
-    case ID_STONE_3x3:
-        OIMD_3x3 break;
-    case ITEMID_HEART_SCALE:
-        SetItemState(posX, posY, 0, 0, itemStateId);
-        SetItemState(posX, posY, 0, 1, itemStateId);
-        SetItemState(posX, posY, 1, 1, itemStateId);
-        break;
-    case ITEMID_HARD_STONE:
-        OIMD_2x2 break;
-    case ITEMID_REVIVE:
-        OIMD_3x3_PLUS break;
-    case ITEMID_STAR_PIECE:
-        OIMD_3x3_PLUS break;
-    case ITEMID_DAMP_ROCK:
-        OIMD_2x2
-            SetItemState(posX, posY, 2, 1, itemStateId);
-        SetItemState(posX, posY, 2, 0, itemStateId);
-        SetItemState(posX, posY, 0, 2, itemStateId);
-        SetItemState(posX, posY, 2, 2, itemStateId);
-        break;
-    case ITEMID_RED_SHARD:
-        OIMD_2x2
-            SetItemState(posX, posY, 1, 2, itemStateId);
-        SetItemState(posX, posY, 2, 0, itemStateId);
-        SetItemState(posX, posY, 0, 2, itemStateId);
-        SetItemState(posX, posY, 2, 2, itemStateId);
-        break;
-    case ITEMID_BLUE_SHARD:
-        OIMD_3x3_PLUS
-            SetItemState(posX, posY, 0, 0, itemStateId);
-        SetItemState(posX, posY, 2, 0, itemStateId);
-        SetItemState(posX, posY, 0, 2, itemStateId);
-        break;
-    case ITEMID_IRON_BALL:
-        OIMD_3x3 break;
-    case ITEMID_REVIVE_MAX:
-        OIMD_3x3 break;
-    case ITEMID_EVER_STONE:
-        OIMD_2x2
-            SetItemState(posX, posY, 2, 0, itemStateId);
-        SetItemState(posX, posY, 3, 0, itemStateId);
-        SetItemState(posX, posY, 2, 1, itemStateId);
-        SetItemState(posX, posY, 3, 1, itemStateId);
-        break;
+        if (shape & (1 << i))
+            Wall_SetCell(&cells, (i % 4) + (i / 4) * WALL_WIDTH);
     }
-}
-
-// Defines && Macros
-#define BORDERCHECK_COND(itemId) posX + ExcavationItemList[(itemId)].left > xBorder || \
-                                     posY + ExcavationItemList[(itemId)].top > yBorder
 
-static bool32 ItemStateCondition(u32 posX, u32 posY, u32 x, u32 y, u32 i)
-{
-    return (sExcavationUiState->itemMap[posX + (x) + (posY + (y)) * 12] == i);
+    Wall_ShiftForward(&cells, &cells, anchor);
+    for (i = 0; i < WALL_PLANE_WORDS; i++)
+        plane->words[i] |= cells.words[i];
 }
 
-static bool32 ItemPlaceable_Cond_2x2(u32 posX, u32 posY, u32 i)
+static void Excavation_PlaceItem(u32 index, u32 itemId, u32 anchor)
 {
-    return (
-        ItemStateCondition(posX, posY, 0, 0, i) ||
-        ItemStateCondition(posX, posY, 0, 1, i) ||
-        ItemStateCondition(posX, posY, 1, 0, i) ||
-        ItemStateCondition(posX, posY, 1, 1, i));
+    DrawItemSprite(anchor % WALL_WIDTH, anchor / WALL_WIDTH, itemId, TAG_PAL_ITEM1 + index);
+    Wall_PlaceShape(&sExcavationUiState->itemPlane[index], ExcavationItemList[itemId].shape, anchor);
 }
 
-static bool32 ItemPlaceable_Cond_3x3(u32 posX, u32 posY, u32 i)
-{
-    return (
-        ItemPlaceable_Cond_2x2(posX, posY, i) ||
-        ItemStateCondition(posX, posY, 2, 0, i) ||
-        ItemStateCondition(posX, posY, 2, 1, i) ||
-        ItemStateCondition(posX, posY, 2, 2, i) ||
-        ItemStateCondition(posX, posY, 0, 2, i) ||
-        ItemStateCondition(posX, posY, 1, 2, i));
-}
+#define TAG_DUMMY 0
 
-static bool32 ItemPlaceable_Cond_3x3_Plus(u32 posX, u32 posY, u32 i)
+static void Excavation_PlaceStone(u32 stoneId, u32 anchor)
 {
-    return (
-        ItemStateCondition(posX, posY, 1, 1, i) ||
-        ItemStateCondition(posX, posY, 0, 1, i) ||
-        ItemStateCondition(posX, posY, 1, 0, i) ||
-        ItemStateCondition(posX, posY, 2, 1, i) ||
-        ItemStateCondition(posX, posY, 1, 2, i));
+    DrawItemSprite(anchor % WALL_WIDTH, anchor / WALL_WIDTH, stoneId, TAG_DUMMY);
+    Wall_PlaceShape(&sExcavationUiState->stonePlane, ExcavationStoneList[stoneId].shape, anchor);
 }
 
-// This function is used to determine wether an item should be placed or not.
-// Items could generate on top of each other if this function isnt used to check if the next placement will overwrite other data in itemMap
-// It does that by checking if the value at position `some x` and `some y` in itemMap, is holding either the value 1,2,3 or 4;
-// If yes, return 0 (false, so item should not be drawn and instead new positions should be generated)
-// If no, return 1 (true) and the item can be drawn to the screen
-//
-// And theres the posX and posY check. They are there to make sure that the item sprite will not be drawn outside the box.
-// *_RIGHT tells whats the max. amount of tiles if you go from left to right (starting with 0)
-// the same with *_BOTTOM but going down from top to bottom
-static u8 CheckIfItemCanBePlaced(u8 itemId, u8 posX, u8 posY, u8 xBorder, u8 yBorder)
+#ifdef EXCAVATION_RUNTIME_WALLS
+static u32 CountBits(u32 word)
 {
-    u8 i;
-
-    for (i = 1; i <= 4; i++)
-    {
-
-        switch (itemId)
-        {
-        case ITEMID_HEART_SCALE:
-            if (
-                ItemStateCondition(posX, posY, 0, 0, i) ||
-                ItemStateCondition(posX, posY, 0, 1, i) ||
-                ItemStateCondition(posX, posY, 1, 1, i) ||
-                BORDERCHECK_COND(itemId))
-            {
-                return 0;
-            }
-            break;
-        case ITEMID_HARD_STONE:
-            if (
-                ItemPlaceable_Cond_2x2(posX, posY, i) ||
-                BORDERCHECK_COND(itemId))
-            {
-                return 0;
-            }
-            break;
-        case ITEMID_REVIVE:
-            if (
-                ItemPlaceable_Cond_3x3_Plus(posX, posY, i) ||
-                BORDERCHECK_COND(itemId))
-            {
-                return 0;
-            }
-            break;
-        case ITEMID_STAR_PIECE:
-            if (
-                ItemPlaceable_Cond_3x3_Plus(posX, posY, i) ||
-                BORDERCHECK_COND(itemId))
-            {
-                return 0;
-            }
-            break;
-        case ITEMID_DAMP_ROCK:
-            if (
-                ItemPlaceable_Cond_2x2(posX, posY, i) ||
-                ItemStateCondition(posX, posY, 2, 1, i) ||
-                ItemStateCondition(posX, posY, 2, 0, i) ||
-                ItemStateCondition(posX, posY, 0, 2, i) ||
-                ItemStateCondition(posX, posY, 2, 2, i) ||
-                BORDERCHECK_COND(itemId))
-            {
-                return 0;
-            }
-            break;
-        case ITEMID_RED_SHARD:
-            if (
-                ItemPlaceable_Cond_2x2(posX, posY, i) ||
-                ItemStateCondition(posX, posY, 1, 2, i) ||
-                ItemStateCondition(posX, posY, 2, 0, i) ||
-                ItemStateCondition(posX, posY, 0, 2, i) ||
-                ItemStateCondition(posX, posY, 2, 2, i) ||
-                BORDERCHECK_COND(itemId))
-            {
-                return 0;
-            }
-            break;
-        case ITEMID_BLUE_SHARD:
-            if (
-                ItemPlaceable_Cond_3x3_Plus(posX, posY, i) ||
-                ItemStateCondition(posX, posY, 0, 0, i) ||
-                ItemStateCondition(posX, posY, 2, 0, i) ||
-                ItemStateCondition(posX, posY, 0, 2, i) ||
-                BORDERCHECK_COND(itemId))
-            {
-                return 0;
-            }
-            break;
-        case ITEMID_IRON_BALL:
-            if (
-                ItemPlaceable_Cond_3x3(posX, posY, i) ||
-                BORDERCHECK_COND(itemId))
-            {
-                return 0;
-            }
-            break;
-        case ITEMID_REVIVE_MAX:
-            if (
-                ItemPlaceable_Cond_3x3(posX, posY, i) ||
-                BORDERCHECK_COND(itemId))
-            {
-                return 0;
-            }
-            break;
-        case ITEMID_EVER_STONE:
-            if (
-                ItemPlaceable_Cond_2x2(posX, posY, i) ||
-                ItemStateCondition(posX, posY, 2, 0, i) ||
-                ItemStateCondition(posX, posY, 3, 0, i) ||
-                ItemStateCondition(posX, posY, 2, 1, i) ||
-                ItemStateCondition(posX, posY, 3, 1, i) ||
-                BORDERCHECK_COND(itemId))
-            {
-                return 0;
-            }
-            break;
-        }
-    }
-    return 1;
+    word = word - ((word >> 1) & 0x55555555);
+    word = (word & 0x33333333) + ((word >> 2) & 0x33333333);
+    word = (word + (word >> 4)) & 0x0F0F0F0F;
+    return (word * 0x01010101) >> 24;
 }
 
-static void DoDrawRandomItem(u8 itemStateId, u8 itemId)
+// Zone Split
+//
+// The wall is splitted into 6x4 tiles zones. Each zone is reserved for 1 item
+//
+// |item1|item3|
+// |item2|item4|
+//
+// Stones go anywhere that's left.
+struct WallZone
 {
-    u8 y;
-    u8 x;
-    u16 rnd;
-    u8 posX;
-    u8 posY;
-    u8 t;
-    u8 canItemBePlaced = 1;
-    u8 isItemPlaced = 0;
-
-    // Zone Split
-    //
-    // The wall is splitted into 4x6 tiles zones. Each zone is reserved for 1 item
-    //
-    // |item1|item3|
-    // |item2|item4|
-
-    switch (itemStateId)
-    {
-    case 1:
-        for (y = 0; y <= 3; y++)
-        {
-            for (x = 0; x <= 5; x++)
-            {
-                if (isItemPlaced == 0)
-                {
-                    if (Random() > 49151)
-                    {
-                        canItemBePlaced = CheckIfItemCanBePlaced(itemId, x, y, 5, 3);
-                        if (canItemBePlaced == 1)
-                        {
-                            DrawItemSprite(x, y, itemId, TAG_PAL_ITEM1);
-                            OverwriteItemMapData(x, y, itemStateId, itemId); // For the collection logic, overwrite the itemmap data
-                            isItemPlaced = 1;
-                            break;
-                        }
-                    }
-                }
-            }
-            // If it hasn't placed an Item (that's very unlikely but while debuggin, this happened), just retry
-            if (y == 3 && isItemPlaced == 0)
-            {
-                y = 0;
-            }
-        }
-    case 2:
-        for (y = 4; y <= 7; y++)
-        {
-            for (x = 0; x <= 5; x++)
-            {
-                if (isItemPlaced == 0)
-                {
-                    if (Random() > 49151)
-                    {
-                        canItemBePlaced = CheckIfItemCanBePlaced(itemId, x, y, 5, 7);
-                        if (canItemBePlaced == 1)
-                        {
-                            DrawItemSprite(x, y, itemId, TAG_PAL_ITEM2);
-                            OverwriteItemMapData(x, y, itemStateId, itemId); // For the collection logic, overwrite the itemmap data
-                            isItemPlaced = 1;
-                            break;
-                        }
-                    }
-                }
-            }
-            if (y == 7 && isItemPlaced == 0)
-            {
-                y = 4;
-            }
-        }
+    u8 left;
+    u8 top;
+    u8 right;
+    u8 bottom;
+};
 
-    case 3:
-        for (y = 0; y <= 3; y++)
-        {
-            for (x = 6; x <= 11; x++)
-            {
-                if (isItemPlaced == 0)
-                {
-                    if (Random() > 49151)
-                    {
-                        canItemBePlaced = CheckIfItemCanBePlaced(itemId, x, y, 11, 3);
-                        if (canItemBePlaced == 1)
-                        {
-                            DrawItemSprite(x, y, itemId, TAG_PAL_ITEM3);
-                            OverwriteItemMapData(x, y, itemStateId, itemId); // For the collection logic, overwrite the itemmap data
-                            isItemPlaced = 1;
-                            break;
-                        }
-                    }
-                }
-            }
-            // If it hasn't placed an Item (that's very unlikely but while debuggin, this happened), just retry
-            if (y == 3 && isItemPlaced == 0)
-            {
-                y = 0;
-            }
-        }
+static const struct WallZone sItemZones[MAX_NUM_BURIED_ITEMS] = {
+    {0, 0, 5, 3},
+    {0, 4, 5, 7},
+    {6, 0, 11, 3},
+    {6, 4, 11, 7},
+};
 
-    case 4:
-        for (y = 4; y <= 7; y++)
-        {
-            for (x = 6; x <= 11; x++)
-            {
-                if (isItemPlaced == 0)
-                {
-                    if (Random() > 49151)
-                    {
-                        canItemBePlaced = CheckIfItemCanBePlaced(itemId, x, y, 11, 7);
-                        if (canItemBePlaced == 1)
-                        {
-                            DrawItemSprite(x, y, itemId, TAG_PAL_ITEM4);
-                            OverwriteItemMapData(x, y, itemStateId, itemId); // For the collection logic, overwrite the itemmap data
-                            isItemPlaced = 1;
-                            break;
-                        }
-                    }
-                }
-            }
-            // If it hasn't placed an Item (that's very unlikely but while debuggin, this happened), just retry
-            if (y == 7 && isItemPlaced == 0)
-            {
-                y = 4;
-            }
-        }
-    }
-}
+static const struct WallZone sStoneZone = {0, 0, WALL_WIDTH - 1, WALL_HEIGHT - 1};
 
-#define TAG_DUMMY 0
+// Finds every cell of the zone a shape of (lastColumn + 1) x (lastRow + 1) cells can be anchored at (its top left corner)
+// without leaving the zone or covering another item or stone, then picks one of them with a single RNG draw.
+//
+// A cell stays a candidate while, for every cell of the shape, the wall cell that far from it is free:
+// that's the occupied plane moved back by the shape cell's offset, so each shape cell costs one shift and one AND.
+// Returns FALSE if the shape fits nowhere.
+static bool32 Wall_FindAnchor(u32 shape, u32 lastColumn, u32 lastRow, const struct WallZone *zone, u32 *anchor)
+{
+    struct WallPlane occupied;
+    struct WallPlane candidates;
+    struct WallPlane blocked;
+    u32 rowBits;
+    u32 count;
+    u32 pick;
+    u32 word;
+    u32 i;
+    u32 y;
 
-// TODO: Fill this function with the rest of the stones
-static void DoDrawRandomStone(u8 itemId)
-{
-    u8 x;
-    u8 y;
-    u8 stoneIsPlaced = 0;
+    if (zone->left + lastColumn > zone->right || zone->top + lastRow > zone->bottom)
+        return FALSE;
 
-    for (y = 0; y < 8; y++)
+    // Corners that keep the whole shape inside the zone
+    rowBits = ((1 << (zone->right - lastColumn - zone->left + 1)) - 1) << zone->left;
+    Wall_Clear(&candidates);
+    for (y = zone->top; y <= zone->bottom - lastRow; y++)
     {
-        for (x = 0; x < 12; x++)
-        {
-            switch (itemId)
-            {
-            case ID_STONE_1x4:
-                if (
-                    sExcavationUiState->itemMap[x + y * 12] == 0 &&
-                    sExcavationUiState->itemMap[x + (y + 1) * 12] == 0 &&
-                    sExcavationUiState->itemMap[x + (y + 2) * 12] == 0 &&
-                    sExcavationUiState->itemMap[x + (y + 3) * 12] == 0 &&
-                    x + ExcavationStoneList[itemId].left < 12 &&
-                    y + ExcavationStoneList[itemId].top < 8 &&
-                    Random() > 60000)
-                {
-                    DrawItemSprite(x, y, itemId, TAG_DUMMY);
-                    // Dont want to use ITEM_TILE_DUG_UP, not sure if something unexpected will happen
-                    OverwriteItemMapData(x, y, 6, itemId);
-                    // Stops the looping so the stone isn't drawn multiple times lmao
-                    x = 11;
-                    y = 7;
-                    stoneIsPlaced = 1;
-                }
-                break;
-            case ID_STONE_4x1:
-                if (
-                    sExcavationUiState->itemMap[x + y * 12] == 0 &&
-                    sExcavationUiState->itemMap[x + 1 + y * 12] == 0 &&
-                    sExcavationUiState->itemMap[x + 2 + y * 12] == 0 &&
-                    sExcavationUiState->itemMap[x + 3 + y * 12] == 0 &&
-                    x + ExcavationStoneList[itemId].left < 12 &&
-                    y + ExcavationStoneList[itemId].top < 8 &&
-                    Random() > 60000)
-                {
-                    DrawItemSprite(x, y, itemId, TAG_DUMMY);
-                    OverwriteItemMapData(x, y, 6, itemId);
-                    x = 11;
-                    y = 7;
-                    stoneIsPlaced = 1;
-                }
-                break;
-            case ID_STONE_2x4:
-                if (
-                    sExcavationUiState->itemMap[x + y * 12] == 0 &&
-                    sExcavationUiState->itemMap[x + (y + 1) * 12] == 0 &&
-                    sExcavationUiState->itemMap[x + (y + 2) * 12] == 0 &&
-                    sExcavationUiState->itemMap[x + (y + 3) * 12] == 0 &&
-                    sExcavationUiState->itemMap[x + 1 + y * 12] == 0 &&
-                    sExcavationUiState->itemMap[x + 1 + (y + 1) * 12] == 0 &&
-                    sExcavationUiState->itemMap[x + 1 + (y + 2) * 12] == 0 &&
-                    sExcavationUiState->itemMap[x + 1 + (y + 3) * 12] == 0 &&
-                    x + ExcavationStoneList[itemId].left < 12 &&
-                    y + ExcavationStoneList[itemId].top < 8 &&
-                    Random() > 60000)
-                {
-                    DrawItemSprite(x, y, itemId, TAG_DUMMY);
-                    OverwriteItemMapData(x, y, 6, itemId);
-                    x = 11;
-                    y = 7;
-                    stoneIsPlaced = 1;
-                }
-                break;
-            case ID_STONE_4x2:
-                if (
-                    sExcavationUiState->itemMap[x + y * 12] == 0 &&
-                    sExcavationUiState->itemMap[x + 1 + y * 12] == 0 &&
-                    sExcavationUiState->itemMap[x + 2 + y * 12] == 0 &&
-                    sExcavationUiState->itemMap[x + 3 + y * 12] == 0 &&
-                    sExcavationUiState->itemMap[x + (y + 1) * 12] == 0 &&
-                    sExcavationUiState->itemMap[x + 1 + (y + 1) * 12] == 0 &&
-                    sExcavationUiState->itemMap[x + 2 + (y + 1) * 12] == 0 &&
-                    sExcavationUiState->itemMap[x + 3 + (y + 1) * 12] == 0 &&
-                    x + ExcavationStoneList[itemId].left < 12 &&
-                    y + ExcavationStoneList[itemId].top < 8 &&
-
-                    Random() > 60000)
-                {
-                    DrawItemSprite(x, y, itemId, TAG_DUMMY);
-                    OverwriteItemMapData(x, y, 6, itemId);
-                    x = 11;
-                    y = 7;
-                    stoneIsPlaced = 1;
-                }
-                break;
-            case ID_STONE_2x2:
-                if (
-                    sExcavationUiState->itemMap[x + y * 12] == 0 &&
-                    sExcavationUiState->itemMap[x + 1 + y * 12] == 0 &&
-                    sExcavationUiState->itemMap[x + (y + 1) * 12] == 0 &&
-                    sExcavationUiState->itemMap[x + 1 + (y + 1) * 12] == 0 &&
-                    x + ExcavationStoneList[itemId].left < 12 &&
-                    y + ExcavationStoneList[itemId].top < 8 &&
-
-                    Random() > 60000)
-                {
-                    DrawItemSprite(x, y, itemId, TAG_DUMMY);
-                    OverwriteItemMapData(x, y, 6, itemId);
-                    x = 11;
-                    y = 7;
-                    stoneIsPlaced = 1;
-                }
-                break;
-            case ID_STONE_3x3:
-                if (
-                    sExcavationUiState->itemMap[x + y * 12] == 0 &&
-                    sExcavationUiState->itemMap[x + 1 + y * 12] == 0 &&
-                    sExcavationUiState->itemMap[x + (y + 1) * 12] == 0 &&
-                    sExcavationUiState->itemMap[x + 1 + (y + 1) * 12] == 0 &&
-                    sExcavationUiState->itemMap[x + 2 + y * 12] == 0 &&
-                    sExcavationUiState->itemMap[x + 2 + (y + 1) * 12] == 0 &&
-                    sExcavationUiState->itemMap[x + 2 + (y + 2) * 12] == 0 &&
-                    sExcavationUiState->itemMap[x + 1 + (y + 2) * 12] == 0 &&
-                    sExcavationUiState->itemMap[x + (y + 2) * 12] == 0 &&
-                    x + ExcavationStoneList[itemId].left < 12 &&
-                    y + ExcavationStoneList[itemId].top < 8 &&
-
-                    Random() > 60000)
-                {
-                    DrawItemSprite(x, y, itemId, TAG_DUMMY);
-                    OverwriteItemMapData(x, y, 6, itemId);
-                    x = 11;
-                    y = 7;
-                    stoneIsPlaced = 1;
-                }
-                break;
-            }
-        }
-        if (stoneIsPlaced == 0 && y == 7)
-        {
-            y = 0;
-        }
+        Wall_Clear(&blocked);
+        blocked.words[0] = rowBits;
+        Wall_ShiftForward(&blocked, &blocked, y * WALL_WIDTH);
+        for (i = 0; i < WALL_PLANE_WORDS; i++)
+            candidates.words[i] |= blocked.words[i];
     }
-}
-
-static void Excavation_CheckItemFound(void)
-{
-    u8 full;
-    u8 stop;
-    u8 i;
-
-    full = sExcavationUiState->Item1_TilesToDigUp;
-    stop = full + 1;
 
-    if (sExcavationUiState->state_item1 < full)
-    {
-        for (i = 0; i < 96; i++)
-        {
-            if (sExcavationUiState->itemMap[i] == 1 && sExcavationUiState->layerMap[i] == 6)
-            {
-                sExcavationUiState->itemMap[i] = ITEM_TILE_DUG_UP;
-                sExcavationUiState->state_item1++;
-            }
-        }
-    }
-    else if (sExcavationUiState->state_item1 == full)
+    Wall_GetOccupied(&occupied);
+    for (i = 0; i < SHAPE_SIZE; i++)
     {
-        PlaySE(SE_SHINY);
-        BeginNormalPaletteFade(0x00040000, 2, 16, 0, RGB_WHITE);
-        sExcavationUiState->state_item1 = stop;
-        SetBuriedItemStatus(0, TRUE);
-        AddBagItem(GetBuriedItemId(0), 1);
+        if (!(shape & (1 << i)))
+            continue;
+        Wall_ShiftBack(&blocked, &occupied, (i % 4) + (i / 4) * WALL_WIDTH);
+        candidates.words[0] &= ~blocked.words[0];
+        candidates.words[1] &= ~blocked.words[1];
+        candidates.words[2] &= ~blocked.words[2];
     }
 
-    full = sExcavationUiState->Item2_TilesToDigUp;
-    stop = full + 1;
+    count = CountBits(candidates.words[0]) + CountBits(candidates.words[1]) + CountBits(candidates.words[2]);
+    if (count == 0)
+        return FALSE;
 
-    if (sExcavationUiState->state_item2 < full)
+    pick = random(count);
+    for (i = 0; i < WALL_PLANE_WORDS; i++)
     {
-        for (i = 0; i < 96; i++)
+        word = candidates.words[i];
+        count = CountBits(word);
+        if (pick >= count)
         {
-            if (sExcavationUiState->itemMap[i] == 2 && sExcavationUiState->layerMap[i] == 6)
-            {
-                sExcavationUiState->itemMap[i] = ITEM_TILE_DUG_UP;
-                sExcavationUiState->state_item2++;
-            }
+            pick -= count;
+            continue;
         }
-    }
-    else if (sExcavationUiState->state_item2 == full)
-    {
-        PlaySE(SE_SHINY);
-        BeginNormalPaletteFade(0x00080000, 2, 16, 0, RGB_WHITE);
-        sExcavationUiState->state_item2 = stop;
-        SetBuriedItemStatus(1, TRUE);
-        AddBagItem(GetBuriedItemId(1), 1);
-    }
 
-    full = sExcavationUiState->Item3_TilesToDigUp;
-    stop = full + 1;
-
-    if (sExcavationUiState->state_item3 < full)
-    {
-        for (i = 0; i < 96; i++)
-        {
-            if (sExcavationUiState->itemMap[i] == 3 && sExcavationUiState->layerMap[i] == 6)
-            {
-                sExcavationUiState->itemMap[i] = ITEM_TILE_DUG_UP;
-                sExcavationUiState->state_item3++;
-            }
-        }
-    }
-    else if (sExcavationUiState->state_item3 == full)
-    {
-        PlaySE(SE_SHINY);
-        BeginNormalPaletteFade(0x00100000, 2, 16, 0, RGB_WHITE);
-        sExcavationUiState->state_item3 = stop;
-        SetBuriedItemStatus(2, TRUE);
-        AddBagItem(GetBuriedItemId(2), 1);
+        // Drop the lower candidates, then find the lowest one left
+        for (; pick != 0; pick--)
+            word &= word - 1;
+        for (*anchor = i * 32; !(word & 1); (*anchor)++)
+            word >>= 1;
+        break;
     }
+    return TRUE;
+}
 
-    full = sExcavationUiState->Item4_TilesToDigUp;
-    stop = full + 1;
-
-    if (sExcavationUiState->state_item4 < full)
-    {
-        for (i = 0; i < 96; i++)
-        {
-            if (sExcavationUiState->itemMap[i] == 4 && sExcavationUiState->layerMap[i] == 6)
-            {
-                sExcavationUiState->itemMap[i] = ITEM_TILE_DUG_UP;
-                sExcavationUiState->state_item4++;
-            }
-        }
-    }
-    else if (sExcavationUiState->state_item4 == full)
-    {
-        PlaySE(SE_SHINY);
-        BeginNormalPaletteFade(0x00200000, 2, 16, 0, RGB_WHITE);
-        sExcavationUiState->state_item4 = stop;
-        SetBuriedItemStatus(3, TRUE);
-        AddBagItem(GetBuriedItemId(3), 1);
-    }
+// An item's zone is empty when it's placed, and every item fits into a zone, so this always finds a spot
+static void DoDrawRandomItem(u8 itemStateId, u8 itemId)
+{
+    const struct ExcavationItem *item = &ExcavationItemList[itemId];
+    u32 anchor;
 
-    for (i = 0; i < 96; i++)
-    {
-        if (sExcavationUiState->itemMap[i] == 6 && sExcavationUiState->layerMap[i] == 6)
-        {
-            sExcavationUiState->itemMap[i] = ITEM_TILE_DUG_UP;
-        }
-    }
+    if (Wall_FindAnchor(item->shape, item->left, item->top, &sItemZones[itemStateId - 1], &anchor))
+        Excavation_PlaceItem(itemStateId - 1, itemId, anchor);
 }
 
-// Randomly generates a terrain, stores the layering in an array and draw the right tiles, with the help of the layer map, to the screen.
-// Use the above function just to draw a tile once (for updating the tile, use Terrain_UpdateLayerTileOnScreen(...); )
-static void Excavation_DrawRandomTerrain(void)
+// A stone that fits nowhere around the items is left out
+static void DoDrawRandomStone(u8 itemId)
 {
-    u8 i;
-    u8 x;
-    u8 y;
-    u8 rnd;
-
-    // Pointer to the tilemap in VRAM
-    u16 *ptr = GetBgTilemapBuffer(2);
+    const struct ExcavationStone *stone = &ExcavationStoneList[itemId];
+    u32 anchor;
 
-    for (i = 0; i < 96; i++)
-    {
-        sExcavationUiState->layerMap[i] = 4;
-    }
+    if (Wall_FindAnchor(stone->shape, stone->left, stone->top, &sStoneZone, &anchor))
+        Excavation_PlaceStone(itemId, anchor);
+}
+#else
+static void Excavation_LoadWallLayout(const struct WallLayout *layout)
+{
+    u32 i;
 
-    for (i = 0; i < 96; i++)
+    for (i = 0; i < MAX_NUM_BURIED_ITEMS; i++)
     {
-        rnd = (Random() >> 14);
-        if (rnd == 0)
-        {
-            sExcavationUiState->layerMap[i] = 2;
-        }
-        else if (rnd == 1 || rnd == 2)
-        {
-            sExcavationUiState->layerMap[i] = 0;
-        }
+        if (layout->itemIds[i] == ITEMID_NONE)
+            continue;
+        SetBuriedItemsId(i, layout->itemIds[i]);
+        Excavation_PlaceItem(i, layout->itemIds[i], layout->itemAnchors[i]);
     }
 
-    i = 0; // Using 'i' again to get the layer of the layer map
-
-    // Using 'x', 'y' and 'i' to draw the right layer_tiles from layerMap to the screen.
-    // Why 'y = 2'? Because we need to have a distance from the top of the screen, which is 32px -> 2 * 16
-    for (y = 2; y < 8 + 2; y++)
+    for (i = 0; i < ARRAY_COUNT(layout->stoneIds); i++)
     {
-        for (x = 0; x < 12 && i < 96; x++, i++)
-        {
-            Terrain_DrawLayerTileToScreen(x, y, sExcavationUiState->layerMap[i], ptr);
-        }
+        if (layout->stoneIds[i] == ITEMID_NONE)
+            continue;
+        Excavation_PlaceStone(layout->stoneIds[i], layout->stoneAnchors[i]);
     }
 }
+#endif
 
-// This function is like 'Terrain_DrawLayerTileToScreen(...);', but for updating a tile AND the layer in the layerMap (we want to sync it)
-static void Terrain_UpdateLayerTileOnScreen(u16 *ptr, s8 ofsX, s8 ofsY)
+// An item is found by the hit that clears the last of its cells. Only the cells the hit dug are looked at.
+static void Excavation_CheckItemsFound(const struct WallPlane *dug)
 {
-    u8 i;
-    u8 tileX;
-    u8 tileY;
-
-    // if ((ofsX + sExcavationUiState->cursorX) > 11 || (ofsX == -1 && sExcavationUiState->cursorX == 0)) {
-    //   ofsX = 0;
-    // }
-
-    i = (sExcavationUiState->cursorY - 2 + ofsY) * 12 + sExcavationUiState->cursorX + ofsX; // Why the minus 2? Because the cursorY value starts at 2, so when calculating the position of the cursor, we have that additional 2 with it!!
-    tileX = sExcavationUiState->cursorX;
-    tileY = sExcavationUiState->cursorY;
-    // Maybe this?
-    // u8 layer = sExcavationUiState->layerMap[sExcavationUiState->cursorY*8 + sExcavationUiState->cursorX];
-
-    // TODO: Change this as well
-    if (sExcavationUiState->cursorX == 0)
-    {
-        tileX = (0 + ofsX) * 2;
-    }
-    else
-    {
-        tileX = (sExcavationUiState->cursorX + ofsX) * 2;
-    }
+    struct WallPlane cleared;
+    u32 index;
+    u32 i;
+    u32 hit;
+    u32 left;
 
-    if (sExcavationUiState->cursorY == 0)
-    {
-        tileY = (0 + ofsY) * 2;
-    }
-    else
+    Wall_GetCleared(&cleared);
+    for (index = 0; index < MAX_NUM_BURIED_ITEMS; index++)
     {
-        tileY = (sExcavationUiState->cursorY + ofsY) * 2;
-    }
+        if (GetBuriedItemStatus(index))
+            continue;
 
-    // Here, case 0 is missing because it will never appear. Why? Because the value we are doing the switch statement on would need to be negative.
-    // Case 6 clears the tile so we can take a look at Bg3 (for the item sprite)!
-    //
-    // Other than that, the tiles here are in order.
+        hit = 0;
+        left = 0;
+        for (i = 0; i < WALL_PLANE_WORDS; i++)
+        {
+            hit |= sExcavationUiState->itemPlane[index].words[i] & dug->words[i] & cleared.words[i];
+            left |= sExcavationUiState->itemPlane[index].words[i] & ~cleared.words[i];
+        }
+        if (hit == 0 || left != 0)
+            continue;
 
-    sExcavationUiState->layerMap[i]++;
+        SetBuriedItemStatus(index, TRUE);
+        AddBagItem(GetBuriedItemId(index), 1);
 
-    switch (sExcavationUiState->layerMap[i])
-    { // Incrementing? Idk if thats the bug for wrong tile replacements...
-    case 1:
-        OverwriteTileDataInTilemapBuffer(0x19, tileX, tileY, ptr, 0x01);
-        OverwriteTileDataInTilemapBuffer(0x1A, tileX + 1, tileY, ptr, 0x01);
-        OverwriteTileDataInTilemapBuffer(0x1E, tileX, tileY + 1, ptr, 0x01);
-        OverwriteTileDataInTilemapBuffer(0x1F, tileX + 1, tileY + 1, ptr, 0x01);
-        break;
-    case 2:
-        OverwriteTileDataInTilemapBuffer(0x10, tileX, tileY, ptr, 0x01);
-        OverwriteTileDataInTilemapBuffer(0x11, tileX + 1, tileY, ptr, 0x01);
-        OverwriteTileDataInTilemapBuffer(0x15, tileX, tileY + 1, ptr, 0x01);
-        OverwriteTileDataInTilemapBuffer(0x16, tileX + 1, tileY + 1, ptr, 0x01);
-        break;
-    case 3:
-        OverwriteTileDataInTilemapBuffer(0x0C, tileX, tileY, ptr, 0x01);
-        OverwriteTileDataInTilemapBuffer(0x0D, tileX + 1, tileY, ptr, 0x01);
-        OverwriteTileDataInTilemapBuffer(0x12, tileX, tileY + 1, ptr, 0x01);
-        OverwriteTileDataInTilemapBuffer(0x13, tileX + 1, tileY + 1, ptr, 0x01);
-        break;
-    case 4:
-        OverwriteTileDataInTilemapBuffer(0x05, tileX, tileY, ptr, 0x01);
-        OverwriteTileDataInTilemapBuffer(0x06, tileX + 1, tileY, ptr, 0x01);
-        OverwriteTileDataInTilemapBuffer(0x0A, tileX, tileY + 1, ptr, 0x01);
-        OverwriteTileDataInTilemapBuffer(0x0B, tileX + 1, tileY + 1, ptr, 0x01);
-        break;
-    case 5:
-        OverwriteTileDataInTilemapBuffer(0x01, tileX, tileY, ptr, 0x01);
-        OverwriteTileDataInTilemapBuffer(0x02, tileX + 1, tileY, ptr, 0x01);
-        OverwriteTileDataInTilemapBuffer(0x03, tileX, tileY + 1, ptr, 0x01);
-        OverwriteTileDataInTilemapBuffer(0x04, tileX + 1, tileY + 1, ptr, 0x01);
-        break;
-    case 6:
-        OverwriteTileDataInTilemapBuffer(0x00, tileX, tileY, ptr, 0x01);
-        OverwriteTileDataInTilemapBuffer(0x00, tileX + 1, tileY, ptr, 0x01);
-        OverwriteTileDataInTilemapBuffer(0x00, tileX, tileY + 1, ptr, 0x01);
-        OverwriteTileDataInTilemapBuffer(0x00, tileX + 1, tileY + 1, ptr, 0x01);
-        break;
+        // Each buried item has a palette slot of its own, looked up rather than assumed to be slot 2 + index
+        sExcavationUiState->foundPaletteMask |= 1 << (16 + IndexOfSpritePaletteTag(TAG_PAL_ITEM1 + index));
     }
 }
 
-// Using this function here to overwrite the tilemap entry when hitting with the pickaxe (blue button is pressed)
-static u8 Terrain_Pickaxe_OverwriteTiles(u16 *ptr)
+// Items found by the same hit flash together
+static void Excavation_FlashFoundItems(void)
 {
-    u8 pos = sExcavationUiState->cursorX + (sExcavationUiState->cursorY - 2) * 12;
-    if (sExcavationUiState->itemMap[pos] != ITEM_TILE_DUG_UP)
-    {
-        if (sExcavationUiState->cursorX != 0)
-        {
-            Terrain_UpdateLayerTileOnScreen(ptr, -1, 0);
-        }
-        if (sExcavationUiState->cursorX != 11)
-        {
-            Terrain_UpdateLayerTileOnScreen(ptr, 1, 0);
-        }
-
-        // We have to add '2' to 7 and 0 because, remember: The cursor spawns at Y_position 2!!!
-        if (sExcavationUiState->cursorY != 9)
-        {
-            Terrain_UpdateLayerTileOnScreen(ptr, 0, 1);
-        }
-        if (sExcavationUiState->cursorY != 2)
-        {
-            Terrain_UpdateLayerTileOnScreen(ptr, 0, -1);
-        }
+    if (sExcavationUiState->foundPaletteMask == 0)
+        return;
 
-        // Center hit
-        Terrain_UpdateLayerTileOnScreen(ptr, 0, 0);
-        return 0;
-    }
-    else
-    {
-        return 1;
-    }
+    PlaySE(SE_SHINY);
+    BeginNormalPaletteFade(sExcavationUiState->foundPaletteMask, 2, 16, 0, RGB_WHITE);
+    sExcavationUiState->foundPaletteMask = 0;
 }
 
-static void Terrain_Hammer_OverwriteTiles(u16 *ptr)
+// Randomly generates a terrain from the seed, stores the layering in the layer planes and draw the right tiles, with the help of the planes, to the screen.
+static void Excavation_DrawRandomTerrain(u32 seed)
 {
-    u8 isItemDugUp;
+    u8 i;
+    u8 rnd;
+    u32 state;
 
-    isItemDugUp = Terrain_Pickaxe_OverwriteTiles(ptr);
-    if (isItemDugUp == 0)
+    // On its own state, so a seed always gives the same terrain
+    ExcavationRng_Seed(&state, seed);
+    for (i = 0; i < 96; i++)
     {
-        // Corners
-        // We have to add '2' to 7 and 0 because, remember: The cursor spawns at Y_position 2!!!
-        if (sExcavationUiState->cursorX != 11 && sExcavationUiState->cursorY != 9)
-        {
-            Terrain_UpdateLayerTileOnScreen(ptr, 1, 1);
-        }
-
-        if (sExcavationUiState->cursorX != 0 && sExcavationUiState->cursorY != 9)
+        rnd = (ExcavationRng_Next(&state) >> 30);
+        if (rnd == 0)
         {
-            Terrain_UpdateLayerTileOnScreen(ptr, -1, 1);
+            Wall_SetLayer(i, 2);
         }
-
-        if (sExcavationUiState->cursorX != 11 && sExcavationUiState->cursorY != 2)
+        else if (rnd == 1 || rnd == 2)
         {
-            Terrain_UpdateLayerTileOnScreen(ptr, 1, -1);
+            Wall_SetLayer(i, 0);
         }
-
-        if (sExcavationUiState->cursorX != 0 && sExcavationUiState->cursorY != 2)
+        else
         {
-            Terrain_UpdateLayerTileOnScreen(ptr, -1, -1);
+            Wall_SetLayer(i, 4);
         }
     }
+
+    Terrain_DrawCells(&sWallAll);
 }
 
 // Used in the Input task.
+// The hammer digs the 3x3 square around the cursor, the pickaxe (blue button is pressed) only the plus inside it.
+// Hitting an item or stone that's already dug up does nothing.
 static void Excavation_UpdateTerrain(void)
 {
-    u16 *ptr = GetBgTilemapBuffer(2);
-    switch (sExcavationUiState->mode)
-    {
-    case RED_BUTTON:
-        Terrain_Hammer_OverwriteTiles(ptr);
-        break;
-    case BLUE_BUTTON:
-        Terrain_Pickaxe_OverwriteTiles(ptr);
-        break;
-    }
+    struct WallPlane stencil;
+    struct WallPlane occupied;
+    // Why the minus 2? Because the cursorY value starts at 2!!
+    u32 cursorX = sExcavationUiState->cursorX;
+    u32 cursorY = sExcavationUiState->cursorY - 2;
+    u32 n = cursorX + cursorY * WALL_WIDTH;
+
+    Wall_GetCleared(&stencil);
+    Wall_GetOccupied(&occupied);
+    if (Wall_TestCell(&stencil, n) && Wall_TestCell(&occupied, n))
+        return;
+
+    Wall_GetStencil(&stencil, cursorX, cursorY, sExcavationUiState->mode == RED_BUTTON);
+    Wall_Dig(&stencil);
+
+    // Redraw only the cells that changed
+    Terrain_DrawCells(&stencil);
+
+    Excavation_CheckItemsFound(&stencil);
 }
 
 static void Task_ExcavationFadeAndExitMenu(u8 taskId)
@@ -2882,6 +2054,9 @@ static void Task_ExcavationFadeAndExitMenu(u8 taskId)
 
 static void Excavation_FreeResources(void)
 {
+    // Our VBlank callback copies from the BG2 tilemap buffer, so it has to stop before anything is freed
+    SetVBlankCallback(NULL);
+
     // Free our data struct and our BG1 tilemap buffer
     if (sExcavationUiState->sBg3TilemapBuffer != NULL)
     {
@@ -0,0 +1,463 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "global.h"
+#include "atlas.h"
+#include "convert_png.h"
+#include "gfx.h"
+#include "util.h"
+
+// Pack sprite frames into one 4bpp sheet.
+
+// Format of a sprite atlas file, line by line:
+// "<FRAME_NAME> <PNG_PATH>"
+//
+// Blank lines and lines starting with '#' are ignored.
+// Each frame is trimmed to the bounding box of its non-transparent pixels,
+// grown to the smallest OAM shape that fits, and appended to the sheet in
+// 1D OBJ mapping order. The header lists each frame's tile offset, OAM
+// shape/size and position within its source image.
+//
+// When a palette file is requested, the frames' palettes are merged into as
+// few 16-color palettes as possible. Colors within the allowed error (squared
+// distance between 5-bit GBA colors) share a slot. The frames are re-indexed
+// and the header lists the palette each frame uses.
+
+#define MAX_LINE_LENGTH 512
+#define MAX_FRAMES 256
+
+struct OamShape {
+	int width;
+	int height;
+	const char *name;
+};
+
+// Every OAM shape, smallest first.
+static const struct OamShape sOamShapes[] = {
+	{ 1, 1, "8x8" },
+	{ 2, 1, "16x8" },
+	{ 1, 2, "8x16" },
+	{ 2, 2, "16x16" },
+	{ 4, 1, "32x8" },
+	{ 1, 4, "8x32" },
+	{ 4, 2, "32x16" },
+	{ 2, 4, "16x32" },
+	{ 4, 4, "32x32" },
+	{ 8, 4, "64x32" },
+	{ 4, 8, "32x64" },
+	{ 8, 8, "64x64" },
+};
+
+struct AtlasFrame {
+	char name[MAX_LINE_LENGTH];
+	int tileOffset;
+	int left;
+	int top;
+	const struct OamShape *shape;
+	unsigned short colors[16];
+	bool colorUsed[16];
+	int numColorsUsed;
+	unsigned char remap[16];
+	int paletteId;
+};
+
+struct AtlasPalette {
+	unsigned short colors[16];
+	int numColors; // including the transparent color
+};
+
+static const struct OamShape *FindOamShape(int tilesWide, int tilesHigh)
+{
+	for (int i = 0; i < (int)(sizeof(sOamShapes) / sizeof(sOamShapes[0])); i++) {
+		if (sOamShapes[i].width >= tilesWide && sOamShapes[i].height >= tilesHigh)
+			return &sOamShapes[i];
+	}
+
+	return NULL;
+}
+
+static unsigned char GetPixel(struct Image *image, int x, int y)
+{
+	if (x < 0 || y < 0 || x >= image->width || y >= image->height)
+		return 0;
+
+	return image->pixels[y * image->width + x];
+}
+
+// Trims the image, appends its tiles to the sheet and fills in the frame.
+static void AddFrame(char *path, struct AtlasFrame *frame, unsigned char **sheet, int *numTiles)
+{
+	struct Image image;
+
+	image.bitDepth = 8;
+	image.tilemap.data.affine = NULL;
+
+	ReadPng(path, &image);
+
+	struct Palette palette;
+
+	if (image.hasPalette) {
+		ReadPngPalette(path, &palette);
+	} else {
+		palette.numColors = 16;
+		for (int i = 0; i < 16; i++)
+			palette.colors[i].red = palette.colors[i].green = palette.colors[i].blue = i * 17;
+	}
+
+	for (int i = 0; i < 16; i++) {
+		struct Color *color = &palette.colors[i < palette.numColors ? i : 0];
+
+		frame->colors[i] = (color->red / 8) | ((color->green / 8) << 5) | ((color->blue / 8) << 10);
+		frame->colorUsed[i] = false;
+	}
+
+	int left = image.width;
+	int top = image.height;
+	int right = 0;
+	int bottom = 0;
+
+	for (int y = 0; y < image.height; y++) {
+		for (int x = 0; x < image.width; x++) {
+			unsigned char pixel = image.pixels[y * image.width + x];
+
+			if (pixel == 0)
+				continue;
+			if (pixel > 15)
+				FATAL_ERROR("\"%s\" uses colors beyond the first 16.\n", path);
+
+			frame->colorUsed[pixel] = true;
+
+			if (x < left)
+				left = x;
+			if (x >= right)
+				right = x + 1;
+			if (y < top)
+				top = y;
+			if (y >= bottom)
+				bottom = y + 1;
+		}
+	}
+
+	if (right == 0) {
+		left = 0;
+		top = 0;
+		right = 1;
+		bottom = 1;
+	}
+
+	// Snap the box to the tile grid.
+	left &= ~7;
+	top &= ~7;
+
+	const struct OamShape *shape = FindOamShape((right - left + 7) / 8, (bottom - top + 7) / 8);
+
+	if (shape == NULL)
+		FATAL_ERROR("\"%s\" is larger than the biggest sprite (64x64) after trimming.\n", path);
+
+	// Keep the grown frame inside the source image where possible.
+	if (left + shape->width * 8 > image.width)
+		left = image.width - shape->width * 8;
+	if (top + shape->height * 8 > image.height)
+		top = image.height - shape->height * 8;
+	if (left < 0)
+		left = 0;
+	if (top < 0)
+		top = 0;
+
+	int frameTiles = shape->width * shape->height;
+
+	*sheet = realloc(*sheet, (*numTiles + frameTiles) * 32);
+
+	if (*sheet == NULL)
+		FATAL_ERROR("Failed to allocate memory for sprite atlas.\n");
+
+	unsigned char *dest = *sheet + *numTiles * 32;
+
+	for (int tileY = 0; tileY < shape->height; tileY++) {
+		for (int tileX = 0; tileX < shape->width; tileX++) {
+			for (int j = 0; j < 8; j++) {
+				for (int k = 0; k < 8; k += 2) {
+					int x = left + tileX * 8 + k;
+					int y = top + tileY * 8 + j;
+
+					*dest++ = GetPixel(&image, x, y) | (GetPixel(&image, x + 1, y) << 4);
+				}
+			}
+		}
+	}
+
+	frame->numColorsUsed = 0;
+	for (int i = 1; i < 16; i++)
+		frame->numColorsUsed += frame->colorUsed[i];
+
+	frame->tileOffset = *numTiles;
+	frame->left = left;
+	frame->top = top;
+	frame->shape = shape;
+	*numTiles += frameTiles;
+
+	FreeImage(&image);
+}
+
+static int ColorDistance(unsigned short a, unsigned short b)
+{
+	int red = (a & 0x1F) - (b & 0x1F);
+	int green = ((a >> 5) & 0x1F) - ((b >> 5) & 0x1F);
+	int blue = ((a >> 10) & 0x1F) - ((b >> 10) & 0x1F);
+
+	return red * red + green * green + blue * blue;
+}
+
+// Adds the frame's colors to a copy of the palette, reusing close enough colors.
+// Returns false if they don't fit, otherwise the number of colors added.
+static bool FitFrameToPalette(struct AtlasFrame *frame, struct AtlasPalette *palette, int maxColorError, int *added, int *error)
+{
+	struct AtlasPalette merged = *palette;
+
+	*error = 0;
+
+	for (int i = 1; i < 16; i++) {
+		if (!frame->colorUsed[i])
+			continue;
+
+		int best = -1;
+		int bestDistance = 0;
+
+		for (int j = 1; j < merged.numColors; j++) {
+			int distance = ColorDistance(frame->colors[i], merged.colors[j]);
+
+			if (best < 0 || distance < bestDistance) {
+				best = j;
+				bestDistance = distance;
+			}
+		}
+
+		if (best < 0 || bestDistance > maxColorError) {
+			if (merged.numColors == 16)
+				return false;
+			best = merged.numColors++;
+			merged.colors[best] = frame->colors[i];
+			bestDistance = 0;
+		}
+
+		frame->remap[i] = best;
+		*error += bestDistance;
+	}
+
+	*added = merged.numColors - palette->numColors;
+	*palette = merged;
+	return true;
+}
+
+// Greedily packs the frames, most colorful first, into the palette that
+// needs the fewest new colors for them.
+static int ClusterPalettes(struct AtlasFrame *frames, int numFrames, struct AtlasPalette *palettes, int maxColorError)
+{
+	int order[MAX_FRAMES];
+	int numPalettes = 0;
+
+	for (int i = 0; i < numFrames; i++) {
+		int j = i;
+
+		while (j > 0 && frames[order[j - 1]].numColorsUsed < frames[i].numColorsUsed) {
+			order[j] = order[j - 1];
+			j--;
+		}
+		order[j] = i;
+	}
+
+	for (int i = 0; i < numFrames; i++) {
+		struct AtlasFrame *frame = &frames[order[i]];
+		int best = -1;
+		int bestAdded = 0;
+		int bestError = 0;
+
+		for (int j = 0; j < numPalettes; j++) {
+			struct AtlasPalette candidate = palettes[j];
+			int added;
+			int error;
+
+			if (!FitFrameToPalette(frame, &candidate, maxColorError, &added, &error))
+				continue;
+
+			if (best < 0 || added < bestAdded || (added == bestAdded && error < bestError)) {
+				best = j;
+				bestAdded = added;
+				bestError = error;
+			}
+		}
+
+		if (best < 0) {
+			if (numPalettes == 16)
+				FATAL_ERROR("The frames need more than 16 palettes.\n");
+
+			best = numPalettes++;
+			palettes[best].colors[0] = frame->colors[0];
+			palettes[best].numColors = 1;
+		}
+
+		int added;
+		int error;
+
+		FitFrameToPalette(frame, &palettes[best], maxColorError, &added, &error);
+		frame->remap[0] = 0;
+		frame->paletteId = best;
+	}
+
+	return numPalettes;
+}
+
+static void RemapFrameColors(struct AtlasFrame *frame, unsigned char *sheet)
+{
+	unsigned char *tiles = sheet + frame->tileOffset * 32;
+	int size = frame->shape->width * frame->shape->height * 32;
+
+	for (int i = 0; i < size; i++)
+		tiles[i] = frame->remap[tiles[i] & 0xF] | (frame->remap[tiles[i] >> 4] << 4);
+}
+
+static void WriteAtlasPalettes(char *path, struct AtlasPalette *palettes, int numPalettes)
+{
+	struct Palette palette;
+
+	palette.numColors = numPalettes * 16;
+
+	for (int i = 0; i < numPalettes; i++) {
+		for (int j = 0; j < 16; j++) {
+			unsigned short color = j < palettes[i].numColors ? palettes[i].colors[j] : 0;
+			struct Color *dest = &palette.colors[i * 16 + j];
+
+			dest->red = (color & 0x1F) * 8;
+			dest->green = ((color >> 5) & 0x1F) * 8;
+			dest->blue = ((color >> 10) & 0x1F) * 8;
+		}
+	}
+
+	WriteGbaPalette(path, &palette);
+}
+
+static void WriteAtlasHeader(char *path, char *atlasPath, struct AtlasFrame *frames, int numFrames, int numPalettes)
+{
+	FILE *fp = fopen(path, "w");
+
+	if (fp == NULL)
+		FATAL_ERROR("Failed to open \"%s\" for writing.\n", path);
+
+	fprintf(fp, "// Generated by gbagfx from %s. Do not edit.\n\n", atlasPath);
+
+	for (int i = 0; i < numFrames; i++)
+		fprintf(fp, "#define %s %d\n", frames[i].name, i);
+	fprintf(fp, "\n#define ATLAS_FRAME_COUNT %d\n", numFrames);
+
+	fprintf(fp, "\n// Start of each frame in the sheet, in tiles.\nstatic const u16 sAtlasTileOffsets[] = {\n");
+	for (int i = 0; i < numFrames; i++)
+		fprintf(fp, "    [%s] = %d,\n", frames[i].name, frames[i].tileOffset);
+
+	fprintf(fp, "};\n\nstatic const u8 sAtlasOamShapes[] = {\n");
+	for (int i = 0; i < numFrames; i++)
+		fprintf(fp, "    [%s] = SPRITE_SHAPE(%s),\n", frames[i].name, frames[i].shape->name);
+
+	fprintf(fp, "};\n\nstatic const u8 sAtlasOamSizes[] = {\n");
+	for (int i = 0; i < numFrames; i++)
+		fprintf(fp, "    [%s] = SPRITE_SIZE(%s),\n", frames[i].name, frames[i].shape->name);
+
+	fprintf(fp, "};\n\n// Frame size and top left corner within the source image, in pixels.\nstatic const u8 sAtlasFrameRects[][4] = {\n");
+	for (int i = 0; i < numFrames; i++)
+		fprintf(fp, "    [%s] = {%d, %d, %d, %d},\n", frames[i].name, frames[i].left, frames[i].top, frames[i].shape->width * 8, frames[i].shape->height * 8);
+
+	fprintf(fp, "};\n\n// OAM and sprite template of each frame, for sprites to keep pointing at. The including file\n"
+	            "// defines ATLAS_OAM_PRIORITY and ATLAS_TILE_TAG: frame n's tiles are loaded with tag\n"
+	            "// ATLAS_TILE_TAG + n. Palettes are left to the caller, which sets oam.paletteNum.\n"
+	            "static const struct OamData sAtlasOams[] = {\n");
+	for (int i = 0; i < numFrames; i++)
+		fprintf(fp, "    [%s] = {.shape = SPRITE_SHAPE(%s), .size = SPRITE_SIZE(%s), .priority = ATLAS_OAM_PRIORITY},\n", frames[i].name, frames[i].shape->name, frames[i].shape->name);
+
+	fprintf(fp, "};\n\nstatic const struct SpriteTemplate sAtlasSpriteTemplates[] = {\n");
+	for (int i = 0; i < numFrames; i++) {
+		fprintf(fp, "    [%s] = {\n", frames[i].name);
+		fprintf(fp, "        .tileTag = ATLAS_TILE_TAG + %s,\n", frames[i].name);
+		fprintf(fp, "        .paletteTag = 0xFFFF,\n");
+		fprintf(fp, "        .oam = &sAtlasOams[%s],\n", frames[i].name);
+		fprintf(fp, "        .anims = gDummySpriteAnimTable,\n");
+		fprintf(fp, "        .images = NULL,\n");
+		fprintf(fp, "        .affineAnims = gDummySpriteAffineAnimTable,\n");
+		fprintf(fp, "        .callback = SpriteCallbackDummy,\n");
+		fprintf(fp, "    },\n");
+	}
+
+	fprintf(fp, "};\n");
+
+	if (numPalettes > 0) {
+		fprintf(fp, "\n#define ATLAS_PALETTE_COUNT %d\n", numPalettes);
+		fprintf(fp, "\n// 16-color palette each frame uses, in the atlas palette file.\nstatic const u8 sAtlasPaletteIds[] = {\n");
+		for (int i = 0; i < numFrames; i++)
+			fprintf(fp, "    [%s] = %d,\n", frames[i].name, frames[i].paletteId);
+		fprintf(fp, "};\n");
+	}
+
+	fclose(fp);
+}
+
+void WriteSpriteAtlas(char *atlasPath, char *outputPath, struct AtlasOptions *options)
+{
+	FILE *fp = fopen(atlasPath, "r");
+
+	if (fp == NULL)
+		FATAL_ERROR("Failed to open \"%s\" for reading.\n", atlasPath);
+
+	struct AtlasFrame *frames = malloc(MAX_FRAMES * sizeof(struct AtlasFrame));
+	unsigned char *sheet = NULL;
+	int numFrames = 0;
+	int numTiles = 0;
+	char line[MAX_LINE_LENGTH];
+	char path[MAX_LINE_LENGTH];
+
+	if (frames == NULL)
+		FATAL_ERROR("Failed to allocate memory for sprite atlas.\n");
+
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		if (strchr(line, '\n') == NULL && !feof(fp))
+			FATAL_ERROR("A line in \"%s\" is too long.\n", atlasPath);
+
+		char *start = line + strspn(line, " \t\r\n");
+
+		if (*start == 0 || *start == '#')
+			continue;
+
+		if (numFrames == MAX_FRAMES)
+			FATAL_ERROR("\"%s\" has more than %d frames.\n", atlasPath, MAX_FRAMES);
+
+		if (sscanf(start, "%s %s", frames[numFrames].name, path) != 2)
+			FATAL_ERROR("Expected \"<FRAME_NAME> <PNG_PATH>\" in \"%s\", got \"%s\".\n", atlasPath, start);
+
+		AddFrame(path, &frames[numFrames], &sheet, &numTiles);
+		numFrames++;
+	}
+
+	fclose(fp);
+
+	if (numFrames == 0)
+		FATAL_ERROR("\"%s\" has no frames.\n", atlasPath);
+
+	int numPalettes = 0;
+
+	if (options->palettePath != NULL) {
+		struct AtlasPalette palettes[16];
+
+		numPalettes = ClusterPalettes(frames, numFrames, palettes, options->maxColorError);
+
+		for (int i = 0; i < numFrames; i++)
+			RemapFrameColors(&frames[i], sheet);
+
+		WriteAtlasPalettes(options->palettePath, palettes, numPalettes);
+	}
+
+	WriteWholeFile(outputPath, sheet, numTiles * 32);
+
+	if (options->headerPath != NULL)
+		WriteAtlasHeader(options->headerPath, atlasPath, frames, numFrames, numPalettes);
+
+	free(sheet);
+	free(frames);
+}
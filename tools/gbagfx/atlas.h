@@ -0,0 +1,12 @@
+#ifndef ATLAS_H
+#define ATLAS_H
+
+struct AtlasOptions {
+    char *headerPath;
+    char *palettePath;
+    int maxColorError;
+};
+
+void WriteSpriteAtlas(char *atlasPath, char *outputPath, struct AtlasOptions *options);
+
+#endif // ATLAS_H
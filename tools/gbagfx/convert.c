@@ -0,0 +1,280 @@
+// Conversion and compression core shared by the gbagfx command line and by
+// tools that link libgbagfx.a to build assets in-process.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "global.h"
+#include "util.h"
+#include "options.h"
+#include "gfx.h"
+#include "convert_png.h"
+#include "jasc_pal.h"
+#include "lz.h"
+#include "rl.h"
+#include "huff.h"
+#include "convert.h"
+
+void InitPngToGbaOptions(struct PngToGbaOptions *options, char *outputFileExtension)
+{
+    options->numTilesMode = NUM_TILES_IGNORE;
+    options->numTiles = 0;
+    options->bitDepth = outputFileExtension[0] - '0';
+    options->metatileWidth = 1;
+    options->metatileHeight = 1;
+    options->tilemapFilePath = NULL;
+    options->isAffineMap = false;
+    options->isTiled = true;
+    options->dataWidth = 1;
+}
+
+unsigned char *EncodePngAsGba(char *inputPath, struct PngToGbaOptions *options, int *size)
+{
+    struct Image image;
+    unsigned char *buffer;
+
+    // Plain tile sheets are converted as the rows are decoded, without loading the whole image.
+    if (options->isTiled && options->tilemapFilePath == NULL)
+    {
+        struct PngRows rows;
+
+        if (OpenPngRows(inputPath, &rows))
+        {
+            buffer = EncodeTileImageRows(options->numTilesMode, options->numTiles, options->metatileWidth, options->metatileHeight, &rows, options->bitDepth, !rows.hasPalette, size);
+            ClosePngRows(&rows);
+            return buffer;
+        }
+    }
+
+    image.bitDepth = options->bitDepth;
+    image.tilemap.data.affine = NULL; // initialize to NULL to avoid issues in FreeImage
+
+    // Keep whole pixels around when building a tilemap, so their palette banks survive.
+    if (options->tilemapFilePath != NULL)
+        image.bitDepth = 8;
+
+    ReadPng(inputPath, &image);
+
+    if (options->tilemapFilePath != NULL)
+    {
+        unsigned char *tilemap;
+        int tilemapSize;
+
+        if (!options->isTiled)
+            FATAL_ERROR("Tilemaps can't be generated for plain images.\n");
+
+        buffer = EncodeDedupedTileImage(options->bitDepth, options->metatileWidth, options->metatileHeight, &image, !image.hasPalette, size, &tilemap, &tilemapSize);
+        WriteWholeFile(options->tilemapFilePath, tilemap, tilemapSize);
+        free(tilemap);
+    }
+    else if (options->isTiled)
+        buffer = EncodeTileImage(options->numTilesMode, options->numTiles, options->metatileWidth, options->metatileHeight, &image, !image.hasPalette, size);
+    else
+        buffer = EncodePlainImage(options->dataWidth, &image, !image.hasPalette, size);
+
+    FreeImage(&image);
+
+    return buffer;
+}
+
+void InitCompressionOptions(struct CompressionOptions *options, char *outputFileExtension)
+{
+    if (strcmp(outputFileExtension, "lz") == 0)
+        options->type = COMPRESSION_LZ;
+    else if (strcmp(outputFileExtension, "rl") == 0)
+        options->type = COMPRESSION_RL;
+    else if (strcmp(outputFileExtension, "huff") == 0)
+        options->type = COMPRESSION_HUFF;
+    else
+        FATAL_ERROR("Unknown compression format \"%s\".\n", outputFileExtension);
+
+    options->overflowSize = 0;
+    options->minDistance = 2; // default, for compatibility with LZ77UnCompVram()
+    options->bitDepth = 4;
+}
+
+// The buffer must have room for options->overflowSize zero bytes past size.
+unsigned char *CompressBuffer(unsigned char *buffer, int size, struct CompressionOptions *options, int *compressedSize)
+{
+    unsigned char *compressedData;
+
+    switch (options->type)
+    {
+    case COMPRESSION_LZ:
+        // The overflow option allows a quirk in some of Ruby/Sapphire's tilesets
+        // to be reproduced. It works by appending a number of zeros to the data
+        // before compressing it and then amending the LZ header's size field to
+        // reflect the expected size. This will cause an overflow when decompressing
+        // the data.
+        compressedData = LZCompress(buffer, size + options->overflowSize, compressedSize, options->minDistance);
+
+        compressedData[1] = (unsigned char)size;
+        compressedData[2] = (unsigned char)(size >> 8);
+        compressedData[3] = (unsigned char)(size >> 16);
+        break;
+    case COMPRESSION_RL:
+        compressedData = RLCompress(buffer, size, compressedSize);
+        break;
+    case COMPRESSION_HUFF:
+        compressedData = HuffCompress(buffer, size, compressedSize, options->bitDepth);
+        break;
+    default:
+        FATAL_ERROR("Unknown compression format.\n");
+    }
+
+    return compressedData;
+}
+
+static bool FileExists(char *path)
+{
+    FILE *fp = fopen(path, "rb");
+
+    if (fp == NULL)
+        return false;
+
+    fclose(fp);
+    return true;
+}
+
+static bool IsTileFileExtension(char *extension)
+{
+    return strcmp(extension, "1bpp") == 0
+        || strcmp(extension, "4bpp") == 0
+        || strcmp(extension, "8bpp") == 0;
+}
+
+static bool IsCompressedFileExtension(char *extension)
+{
+    return strcmp(extension, "lz") == 0
+        || strcmp(extension, "rl") == 0;
+}
+
+// Returns a newly allocated copy of the path with its last extension replaced.
+static char *ReplaceExtension(char *path, char *extension)
+{
+    char *stem = GetPathWithoutExtension(path);
+    char *result = malloc(strlen(stem) + strlen(extension) + 2);
+
+    if (result == NULL)
+        FATAL_ERROR("Failed to allocate memory for path.\n");
+
+    sprintf(result, "%s.%s", stem, extension);
+    free(stem);
+
+    return result;
+}
+
+// Asset sources follow the makefile's default rules:
+//   foo.1bpp/4bpp/8bpp <- foo.png
+//   foo.gbapal         <- foo.pal, or foo.png if there is no .pal
+//   foo.X.lz/rl        <- foo.X, which may itself be built from a source
+// Returns a newly allocated path to the file the asset is ultimately built
+// from, or NULL if the path isn't something gbagfx builds by default.
+char *FindAssetSource(char *path)
+{
+    char *extension = GetFileExtensionAfterDot(path);
+    char *source = NULL;
+
+    if (extension == NULL)
+        return NULL;
+
+    if (IsTileFileExtension(extension))
+    {
+        source = ReplaceExtension(path, "png");
+    }
+    else if (strcmp(extension, "gbapal") == 0)
+    {
+        source = ReplaceExtension(path, "pal");
+
+        if (!FileExists(source))
+        {
+            free(source);
+            source = ReplaceExtension(path, "png");
+        }
+    }
+    else if (IsCompressedFileExtension(extension))
+    {
+        char *uncompressedPath = GetPathWithoutExtension(path);
+
+        source = FindAssetSource(uncompressedPath);
+
+        if (source == NULL && FileExists(uncompressedPath))
+            return uncompressedPath;
+
+        free(uncompressedPath);
+        return source;
+    }
+
+    if (source != NULL && !FileExists(source))
+    {
+        free(source);
+        return NULL;
+    }
+
+    return source;
+}
+
+// Builds the asset at path in memory from its source, the same way the
+// default makefile rules would, without writing any files.
+unsigned char *BuildAsset(char *path, int *size)
+{
+    char *extension = GetFileExtensionAfterDot(path);
+    unsigned char *buffer = NULL;
+
+    if (extension == NULL)
+        FATAL_ERROR("Don't know how to build \"%s\".\n", path);
+
+    if (IsTileFileExtension(extension))
+    {
+        struct PngToGbaOptions options;
+        char *source = ReplaceExtension(path, "png");
+
+        InitPngToGbaOptions(&options, extension);
+        buffer = EncodePngAsGba(source, &options, size);
+        free(source);
+    }
+    else if (strcmp(extension, "gbapal") == 0)
+    {
+        struct Palette palette = {};
+        char *source = FindAssetSource(path);
+
+        if (source == NULL)
+            FATAL_ERROR("No palette source for \"%s\".\n", path);
+
+        if (strcmp(GetFileExtensionAfterDot(source), "pal") == 0)
+            ReadJascPalette(source, &palette);
+        else
+            ReadPngPalette(source, &palette);
+
+        buffer = EncodeGbaPalette(&palette, size);
+        free(source);
+    }
+    else if (IsCompressedFileExtension(extension))
+    {
+        struct CompressionOptions options;
+        char *uncompressedPath = GetPathWithoutExtension(path);
+        char *source = FindAssetSource(uncompressedPath);
+        int uncompressedSize;
+        unsigned char *uncompressed;
+
+        InitCompressionOptions(&options, extension);
+
+        if (source != NULL)
+            uncompressed = BuildAsset(uncompressedPath, &uncompressedSize);
+        else
+            uncompressed = ReadWholeFile(uncompressedPath, &uncompressedSize);
+
+        buffer = CompressBuffer(uncompressed, uncompressedSize, &options, size);
+
+        free(uncompressed);
+        free(source);
+        free(uncompressedPath);
+    }
+    else
+    {
+        FATAL_ERROR("Don't know how to build \"%s\".\n", path);
+    }
+
+    return buffer;
+}
@@ -0,0 +1,21 @@
+#ifndef CONVERT_H
+#define CONVERT_H
+
+#include "options.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void InitPngToGbaOptions(struct PngToGbaOptions *options, char *outputFileExtension);
+unsigned char *EncodePngAsGba(char *inputPath, struct PngToGbaOptions *options, int *size);
+void InitCompressionOptions(struct CompressionOptions *options, char *outputFileExtension);
+unsigned char *CompressBuffer(unsigned char *buffer, int size, struct CompressionOptions *options, int *compressedSize);
+char *FindAssetSource(char *path);
+unsigned char *BuildAsset(char *path, int *size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CONVERT_H
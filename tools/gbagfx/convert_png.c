@@ -62,7 +62,7 @@ static unsigned char *ConvertBitDepth(unsigned char *src, int srcBitDepth, int d
 
         for (j = 8 - srcBitDepth; j >= 0; j -= srcBitDepth)
         {
-            unsigned char pixel = (srcByte >> j) % (1 << destBitDepth);
+            unsigned char pixel = ((srcByte >> j) & ((1 << srcBitDepth) - 1)) % (1 << destBitDepth);
             *dest |= pixel << destBit;
             destBit -= destBitDepth;
             if (destBit < 0)
@@ -133,6 +133,113 @@ void ReadPng(char *path, struct Image *image)
     }
 }
 
+static unsigned char GetRowPixel(unsigned char *row, int i, int bitDepth)
+{
+    int bit = i * bitDepth;
+    int shift = 8 - bitDepth - (bit & 7);
+
+    return (row[bit >> 3] >> shift) & ((1 << bitDepth) - 1);
+}
+
+static void SetRowPixel(unsigned char *row, int i, int bitDepth, unsigned char pixel)
+{
+    int bit = i * bitDepth;
+    int shift = 8 - bitDepth - (bit & 7);
+    unsigned char mask = ((1 << bitDepth) - 1) << shift;
+
+    row[bit >> 3] = (row[bit >> 3] & ~mask) | ((pixel << shift) & mask);
+}
+
+// Converts one row to another bit depth without a second buffer.
+// Widening works from the right end so no source pixel is overwritten before
+// it's read; narrowing works from the left for the same reason.
+static void ConvertRowBitDepth(unsigned char *row, int width, int srcBitDepth, int destBitDepth)
+{
+    if (srcBitDepth == destBitDepth)
+        return;
+
+    if (destBitDepth > srcBitDepth)
+    {
+        for (int i = width - 1; i >= 0; i--)
+            SetRowPixel(row, i, destBitDepth, GetRowPixel(row, i, srcBitDepth));
+    }
+    else
+    {
+        for (int i = 0; i < width; i++)
+            SetRowPixel(row, i, destBitDepth, GetRowPixel(row, i, srcBitDepth));
+    }
+}
+
+// Starts reading a PNG row by row. Interlaced images can't be streamed, so
+// false is returned for them and the caller should use ReadPng instead.
+bool OpenPngRows(char *path, struct PngRows *rows)
+{
+    png_structp png_ptr;
+    png_infop info_ptr;
+
+    FILE *fp = PngReadOpen(path, &png_ptr, &info_ptr);
+
+    int color_type = png_get_color_type(png_ptr, info_ptr);
+
+    if (color_type != PNG_COLOR_TYPE_GRAY && color_type != PNG_COLOR_TYPE_PALETTE)
+        FATAL_ERROR("\"%s\" has an unsupported color type.\n", path);
+
+    if (png_get_interlace_type(png_ptr, info_ptr) != PNG_INTERLACE_NONE)
+    {
+        png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+        fclose(fp);
+        return false;
+    }
+
+    rows->fp = fp;
+    rows->pngStruct = png_ptr;
+    rows->pngInfo = info_ptr;
+    rows->path = path;
+    rows->width = png_get_image_width(png_ptr, info_ptr);
+    rows->height = png_get_image_height(png_ptr, info_ptr);
+    rows->bitDepth = png_get_bit_depth(png_ptr, info_ptr);
+    rows->hasPalette = (color_type == PNG_COLOR_TYPE_PALETTE);
+    rows->rowsRead = 0;
+
+    return true;
+}
+
+// Reads the next rows into dest, one after another at the destination bit depth.
+// dest must have room for the last row at the source bit depth too.
+void ReadPngRows(struct PngRows *rows, unsigned char *dest, int numRows, int destBitDepth)
+{
+    png_structp png_ptr = rows->pngStruct;
+    int pitch = (rows->width * destBitDepth + 7) / 8;
+
+    if (rows->bitDepth != destBitDepth && rows->bitDepth != 1 && rows->bitDepth != 2 && rows->bitDepth != 4 && rows->bitDepth != 8)
+        FATAL_ERROR("Bit depth of image must be 1, 2, 4, or 8.\n");
+
+    if (rows->rowsRead + numRows > rows->height)
+        FATAL_ERROR("Tried to read past the end of \"%s\".\n", rows->path);
+
+    if (setjmp(png_jmpbuf(png_ptr)))
+        FATAL_ERROR("Error reading from \"%s\".\n", rows->path);
+
+    for (int i = 0; i < numRows; i++)
+    {
+        unsigned char *row = dest + i * pitch;
+
+        png_read_row(png_ptr, row, NULL);
+        ConvertRowBitDepth(row, rows->width, rows->bitDepth, destBitDepth);
+    }
+
+    rows->rowsRead += numRows;
+}
+
+void ClosePngRows(struct PngRows *rows)
+{
+    png_structp png_ptr = rows->pngStruct;
+    png_infop info_ptr = rows->pngInfo;
+
+    png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+    fclose(rows->fp);
+}
+
 void ReadPngPalette(char *path, struct Palette *palette)
 {
     png_structp png_ptr;
@@ -3,9 +3,27 @@
 #ifndef CONVERT_PNG_H
 #define CONVERT_PNG_H
 
+#include <stdio.h>
+#include <stdbool.h>
 #include "gfx.h"
 
+// A PNG being read a few rows at a time.
+struct PngRows {
+    FILE *fp;
+    void *pngStruct;
+    void *pngInfo;
+    char *path;
+    int width;
+    int height;
+    int bitDepth;
+    bool hasPalette;
+    int rowsRead;
+};
+
 void ReadPng(char *path, struct Image *image);
+bool OpenPngRows(char *path, struct PngRows *rows);
+void ReadPngRows(struct PngRows *rows, unsigned char *dest, int numRows, int destBitDepth);
+void ClosePngRows(struct PngRows *rows);
 void WritePng(char *path, struct Image *image);
 void ReadPngPalette(char *path, struct Palette *palette);
 
@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 #include "global.h"
 #include "font.h"
 #include "gfx.h"
@@ -324,3 +325,129 @@ void WriteFullwidthJapaneseFont(char *path, struct Image *image)
 
 	free(buffer);
 }
+
+// Layout of the CJK glyph codes in charmap.txt: a lead byte from 01 to 1E,
+// skipping 06 and 1B, then a trail byte from 00 to F6. The last glyph is 1E5D.
+// A full CJK font sheet holds the glyphs in code order, with no cells for the gaps.
+#define CJK_FIRST_LEAD      0x01
+#define CJK_TRAILS_PER_LEAD 0xF7
+#define CJK_LAST_CODE       0x1E5D
+
+static const int sSkippedCjkLeads[] = { 0x06, 0x1B };
+
+// Returns the cell of the code's glyph in a full CJK font sheet, or -1 if
+// the code isn't a CJK glyph.
+static int GetCjkGlyphIndex(long code)
+{
+	int lead = code >> 8;
+	int trail = code & 0xFF;
+	int row = lead - CJK_FIRST_LEAD;
+
+	if (lead < CJK_FIRST_LEAD || code > CJK_LAST_CODE || trail >= CJK_TRAILS_PER_LEAD)
+		return -1;
+
+	for (int i = 0; i < (int)(sizeof(sSkippedCjkLeads) / sizeof(sSkippedCjkLeads[0])); i++) {
+		if (lead == sSkippedCjkLeads[i])
+			return -1;
+		if (lead > sSkippedCjkLeads[i])
+			row--;
+	}
+
+	return row * CJK_TRAILS_PER_LEAD + trail;
+}
+
+static int ReadGlyphList(char *path, unsigned short **codes_p)
+{
+	int fileSize;
+	unsigned char *buffer = ReadWholeFileZeroPadded(path, &fileSize, 1);
+	unsigned short *codes = malloc((fileSize / 2 + 1) * sizeof(unsigned short));
+	int numCodes = 0;
+	char *s = (char *)buffer;
+
+	if (codes == NULL)
+		FATAL_ERROR("Failed to allocate memory for glyph list.\n");
+
+	while (*s != 0) {
+		char *end;
+		long code = strtol(s, &end, 16);
+
+		if (end == s) {
+			s++;
+			continue;
+		}
+
+		if (GetCjkGlyphIndex(code) < 0)
+			FATAL_ERROR("Glyph code %lX in \"%s\" isn't a CJK glyph.\n", code, path);
+
+		if (numCodes > 0 && code <= codes[numCodes - 1])
+			FATAL_ERROR("Glyph codes in \"%s\" must be sorted and unique.\n", path);
+
+		codes[numCodes++] = code;
+		s = end;
+	}
+
+	free(buffer);
+
+	*codes_p = codes;
+	return numCodes;
+}
+
+static void WriteGlyphRemapHeader(char *path, char *glyphListPath, unsigned short *codes, int numCodes)
+{
+	FILE *fp = fopen(path, "w");
+
+	if (fp == NULL)
+		FATAL_ERROR("Failed to open \"%s\" for writing.\n", path);
+
+	fprintf(fp, "// Generated by gbagfx from %s. Do not edit.\n\n", glyphListPath);
+	fprintf(fp, "#define FONT_SUBSET_GLYPH_COUNT %d\n\n", numCodes);
+	fprintf(fp, "// Charmap code of each glyph in the subset font, ascending, so a code's\n// glyph can be found with a binary search. Ends with 0xFFFF so the table is\n// never empty.\n");
+	fprintf(fp, "static const u16 sFontSubsetGlyphCodes[FONT_SUBSET_GLYPH_COUNT + 1] = {\n");
+
+	for (int i = 0; i < numCodes; i++)
+		fprintf(fp, "    0x%04X,\n", codes[i]);
+
+	fprintf(fp, "    0xFFFF,\n};\n");
+	fclose(fp);
+}
+
+// Cuts a full CJK font sheet down to the glyphs in the list, in list order,
+// and optionally writes the table mapping the new glyph indices back to codes.
+void SubsetFullwidthFont(struct Image *image, char *glyphListPath, char *headerPath)
+{
+	if (image->width != 256)
+		FATAL_ERROR("The width of the font image (%d) is not 256.\n", image->width);
+
+	unsigned short *codes;
+	int numCodes = ReadGlyphList(glyphListPath, &codes);
+	int numGlyphs = (image->height / 16) * 16;
+	int numRows = numCodes > 0 ? (numCodes + 15) / 16 : 1;
+	int rowSize = image->width * image->bitDepth / 8;
+	int glyphRowSize = 16 * image->bitDepth / 8;
+	unsigned char *pixels = calloc(numRows * 16, rowSize);
+
+	if (pixels == NULL)
+		FATAL_ERROR("Failed to allocate memory for font.\n");
+
+	for (int i = 0; i < numCodes; i++) {
+		int glyph = GetCjkGlyphIndex(codes[i]);
+
+		if (glyph >= numGlyphs)
+			FATAL_ERROR("Glyph code %04X is past the end of the font (%d glyphs).\n", codes[i], numGlyphs);
+
+		unsigned char *src = image->pixels + (glyph / 16) * 16 * rowSize + (glyph % 16) * glyphRowSize;
+		unsigned char *dest = pixels + (i / 16) * 16 * rowSize + (i % 16) * glyphRowSize;
+
+		for (int y = 0; y < 16; y++)
+			memcpy(dest + y * rowSize, src + y * rowSize, glyphRowSize);
+	}
+
+	free(image->pixels);
+	image->pixels = pixels;
+	image->height = numRows * 16;
+
+	if (headerPath != NULL)
+		WriteGlyphRemapHeader(headerPath, glyphListPath, codes, numCodes);
+
+	free(codes);
+}
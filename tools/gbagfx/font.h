@@ -12,5 +12,6 @@ void ReadHalfwidthJapaneseFont(char *path, struct Image *image);
 void WriteHalfwidthJapaneseFont(char *path, struct Image *image);
 void ReadFullwidthJapaneseFont(char *path, struct Image *image);
 void WriteFullwidthJapaneseFont(char *path, struct Image *image);
+void SubsetFullwidthFont(struct Image *image, char *glyphListPath, char *headerPath);
 
 #endif // FONT_H
@@ -5,8 +5,12 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "global.h"
 #include "gfx.h"
+#include "convert_png.h"
 #include "util.h"
 
 #define GET_GBA_PAL_RED(x)   (((x) >>  0) & 0x1F)
@@ -19,6 +23,17 @@
 
 #define DOWNCONVERT_BIT_DEPTH(x) ((x) / 8)
 
+#define REVERSE_BIT_ORDER(x) ({ \
+      ((((x) >> 7) & 1) << 0)   \
+    | ((((x) >> 6) & 1) << 1)   \
+    | ((((x) >> 5) & 1) << 2)   \
+    | ((((x) >> 4) & 1) << 3)   \
+    | ((((x) >> 3) & 1) << 4)   \
+    | ((((x) >> 2) & 1) << 5)   \
+    | ((((x) >> 1) & 1) << 6)   \
+    | ((((x) >> 0) & 1) << 7);  \
+})
+
 static void AdvanceMetatilePosition(int *subTileX, int *subTileY, int *metatileX, int *metatileY, int metatilesWide, int metatileWidth, int metatileHeight)
 {
 	(*subTileX)++;
@@ -36,172 +51,149 @@ static void AdvanceMetatilePosition(int *subTileX, int *subTileY, int *metatileX
 	}
 }
 
-static void ConvertFromTiles1Bpp(unsigned char *src, unsigned char *dest, int numTiles, int metatilesWide, int metatileWidth, int metatileHeight, bool invertColors)
+// Walks the metatile order once and returns, for each tile, the offset of its
+// top row in the linear pixel buffer.
+static int *BuildTileOffsets(int numTiles, int metatilesWide, int metatileWidth, int metatileHeight, int pitch, int tileRowSize)
 {
 	int subTileX = 0;
 	int subTileY = 0;
 	int metatileX = 0;
 	int metatileY = 0;
-	int pitch = metatilesWide * metatileWidth;
+	int *offsets = malloc(numTiles * sizeof(int));
+
+	if (offsets == NULL)
+		FATAL_ERROR("Failed to allocate memory for tile offsets.\n");
 
 	for (int i = 0; i < numTiles; i++) {
-		for (int j = 0; j < 8; j++) {
-			int destY = (metatileY * metatileHeight + subTileY) * 8 + j;
-			int destX = metatileX * metatileWidth + subTileX;
-			unsigned char srcPixelOctet = *src++;
-			unsigned char *destPixelOctet = &dest[destY * pitch + destX];
-
-			for (int k = 0; k < 8; k++) {
-				*destPixelOctet <<= 1;
-				*destPixelOctet |= (srcPixelOctet & 1) ^ invertColors;
-				srcPixelOctet >>= 1;
-			}
-		}
+		int y = (metatileY * metatileHeight + subTileY) * 8;
+		int x = (metatileX * metatileWidth + subTileX) * tileRowSize;
+
+		offsets[i] = y * pitch + x;
 
 		AdvanceMetatilePosition(&subTileX, &subTileY, &metatileX, &metatileY, metatilesWide, metatileWidth, metatileHeight);
 	}
+
+	return offsets;
 }
 
-static void ConvertFromTiles4Bpp(unsigned char *src, unsigned char *dest, int numTiles, int metatilesWide, int metatileWidth, int metatileHeight, bool invertColors)
+// The tile kernels below copy one 8x8 tile between two buffers with the given
+// row pitches. Converting between the linear and tiled layouts is the same
+// per-row transform in both directions, so each kernel serves both.
+
+static void CopyTile1Bpp(unsigned char *dest, int destPitch, unsigned char *src, int srcPitch, bool invertColors)
 {
-	int subTileX = 0;
-	int subTileY = 0;
-	int metatileX = 0;
-	int metatileY = 0;
-	int pitch = (metatilesWide * metatileWidth) * 4;
+	static unsigned char reversed[256];
+	static bool initialized;
 
-	for (int i = 0; i < numTiles; i++) {
-		for (int j = 0; j < 8; j++) {
-			int destY = (metatileY * metatileHeight + subTileY) * 8 + j;
-
-			for (int k = 0; k < 4; k++) {
-				int destX = (metatileX * metatileWidth + subTileX) * 4 + k;
-				unsigned char srcPixelPair = *src++;
-				unsigned char leftPixel = srcPixelPair & 0xF;
-				unsigned char rightPixel = srcPixelPair >> 4;
-
-				if (invertColors) {
-					leftPixel = 15 - leftPixel;
-					rightPixel = 15 - rightPixel;
-				}
+	if (!initialized) {
+		for (int i = 0; i < 256; i++)
+			reversed[i] = REVERSE_BIT_ORDER(i);
+		initialized = true;
+	}
 
-				dest[destY * pitch + destX] = (leftPixel << 4) | rightPixel;
-			}
-		}
+	unsigned char mask = invertColors ? 0xFF : 0x00;
 
-		AdvanceMetatilePosition(&subTileX, &subTileY, &metatileX, &metatileY, metatilesWide, metatileWidth, metatileHeight);
-	}
+	for (int j = 0; j < 8; j++)
+		dest[j * destPitch] = reversed[src[j * srcPitch]] ^ mask;
 }
 
-static void ConvertFromTiles8Bpp(unsigned char *src, unsigned char *dest, int numTiles, int metatilesWide, int metatileWidth, int metatileHeight, bool invertColors)
-{
-	int subTileX = 0;
-	int subTileY = 0;
-	int metatileX = 0;
-	int metatileY = 0;
-	int pitch = (metatilesWide * metatileWidth) * 8;
+#ifdef __SSE2__
 
-	for (int i = 0; i < numTiles; i++) {
-		for (int j = 0; j < 8; j++) {
-			int destY = (metatileY * metatileHeight + subTileY) * 8 + j;
+static void CopyTile4Bpp(unsigned char *dest, int destPitch, unsigned char *src, int srcPitch, bool invertColors)
+{
+	uint32_t rows[8];
 
-			for (int k = 0; k < 8; k++) {
-				int destX = (metatileX * metatileWidth + subTileX) * 8 + k;
-				unsigned char srcPixel = *src++;
+	for (int j = 0; j < 8; j++)
+		memcpy(&rows[j], &src[j * srcPitch], 4);
 
-				if (invertColors)
-					srcPixel = 255 - srcPixel;
+	__m128i lowNybbles = _mm_set1_epi8(0x0F);
+	__m128i mask = _mm_set1_epi8(invertColors ? 0xFF : 0x00);
 
-				dest[destY * pitch + destX] = srcPixel;
-			}
-		}
+	for (int j = 0; j < 8; j += 4) {
+		__m128i v = _mm_loadu_si128((__m128i *)&rows[j]);
 
-		AdvanceMetatilePosition(&subTileX, &subTileY, &metatileX, &metatileY, metatilesWide, metatileWidth, metatileHeight);
+		v = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(v, 4), lowNybbles), _mm_slli_epi16(_mm_and_si128(v, lowNybbles), 4));
+		_mm_storeu_si128((__m128i *)&rows[j], _mm_xor_si128(v, mask));
 	}
+
+	for (int j = 0; j < 8; j++)
+		memcpy(&dest[j * destPitch], &rows[j], 4);
 }
 
-static void ConvertToTiles1Bpp(unsigned char *src, unsigned char *dest, int numTiles, int metatilesWide, int metatileWidth, int metatileHeight, bool invertColors)
+static void CopyTile8Bpp(unsigned char *dest, int destPitch, unsigned char *src, int srcPitch, bool invertColors)
 {
-	int subTileX = 0;
-	int subTileY = 0;
-	int metatileX = 0;
-	int metatileY = 0;
-	int pitch = metatilesWide * metatileWidth;
+	__m128i mask = _mm_set1_epi8(invertColors ? 0xFF : 0x00);
 
-	for (int i = 0; i < numTiles; i++) {
-		for (int j = 0; j < 8; j++) {
-			int srcY = (metatileY * metatileHeight + subTileY) * 8 + j;
-			int srcX = metatileX * metatileWidth + subTileX;
-			unsigned char srcPixelOctet = src[srcY * pitch + srcX];
-			unsigned char *destPixelOctet = dest++;
-
-			for (int k = 0; k < 8; k++) {
-				*destPixelOctet <<= 1;
-				*destPixelOctet |= (srcPixelOctet & 1) ^ invertColors;
-				srcPixelOctet >>= 1;
-			}
-		}
+	for (int j = 0; j < 8; j += 2) {
+		__m128i v = _mm_unpacklo_epi64(_mm_loadl_epi64((__m128i *)&src[j * srcPitch]), _mm_loadl_epi64((__m128i *)&src[(j + 1) * srcPitch]));
 
-		AdvanceMetatilePosition(&subTileX, &subTileY, &metatileX, &metatileY, metatilesWide, metatileWidth, metatileHeight);
+		v = _mm_xor_si128(v, mask);
+		_mm_storel_epi64((__m128i *)&dest[j * destPitch], v);
+		_mm_storel_epi64((__m128i *)&dest[(j + 1) * destPitch], _mm_unpackhi_epi64(v, v));
 	}
 }
 
-static void ConvertToTiles4Bpp(unsigned char *src, unsigned char *dest, int numTiles, int metatilesWide, int metatileWidth, int metatileHeight, bool invertColors)
-{
-	int subTileX = 0;
-	int subTileY = 0;
-	int metatileX = 0;
-	int metatileY = 0;
-	int pitch = (metatilesWide * metatileWidth) * 4;
+#else
 
-	for (int i = 0; i < numTiles; i++) {
-		for (int j = 0; j < 8; j++) {
-			int srcY = (metatileY * metatileHeight + subTileY) * 8 + j;
-
-			for (int k = 0; k < 4; k++) {
-				int srcX = (metatileX * metatileWidth + subTileX) * 4 + k;
-				unsigned char srcPixelPair = src[srcY * pitch + srcX];
-				unsigned char leftPixel = srcPixelPair >> 4;
-				unsigned char rightPixel = srcPixelPair & 0xF;
-
-				if (invertColors) {
-					leftPixel = 15 - leftPixel;
-					rightPixel = 15 - rightPixel;
-				}
+static void CopyTile4Bpp(unsigned char *dest, int destPitch, unsigned char *src, int srcPitch, bool invertColors)
+{
+	uint32_t mask = invertColors ? 0xFFFFFFFF : 0;
 
-				*dest++ = (rightPixel << 4) | leftPixel;
-			}
-		}
+	for (int j = 0; j < 8; j++) {
+		uint32_t row;
 
-		AdvanceMetatilePosition(&subTileX, &subTileY, &metatileX, &metatileY, metatilesWide, metatileWidth, metatileHeight);
+		memcpy(&row, &src[j * srcPitch], 4);
+		row = ((row >> 4) & 0x0F0F0F0F) | ((row & 0x0F0F0F0F) << 4);
+		row ^= mask;
+		memcpy(&dest[j * destPitch], &row, 4);
 	}
 }
 
-static void ConvertToTiles8Bpp(unsigned char *src, unsigned char *dest, int numTiles, int metatilesWide, int metatileWidth, int metatileHeight, bool invertColors)
+static void CopyTile8Bpp(unsigned char *dest, int destPitch, unsigned char *src, int srcPitch, bool invertColors)
 {
-	int subTileX = 0;
-	int subTileY = 0;
-	int metatileX = 0;
-	int metatileY = 0;
-	int pitch = (metatilesWide * metatileWidth) * 8;
+	uint64_t mask = invertColors ? 0xFFFFFFFFFFFFFFFFULL : 0;
 
-	for (int i = 0; i < numTiles; i++) {
-		for (int j = 0; j < 8; j++) {
-			int srcY = (metatileY * metatileHeight + subTileY) * 8 + j;
+	for (int j = 0; j < 8; j++) {
+		uint64_t row;
 
-			for (int k = 0; k < 8; k++) {
-				int srcX = (metatileX * metatileWidth + subTileX) * 8 + k;
-				unsigned char srcPixel = src[srcY * pitch + srcX];
+		memcpy(&row, &src[j * srcPitch], 8);
+		row ^= mask;
+		memcpy(&dest[j * destPitch], &row, 8);
+	}
+}
 
-				if (invertColors)
-					srcPixel = 255 - srcPixel;
+#endif // __SSE2__
 
-				*dest++ = srcPixel;
-			}
-		}
+typedef void (*CopyTileFunc)(unsigned char *, int, unsigned char *, int, bool);
 
-		AdvanceMetatilePosition(&subTileX, &subTileY, &metatileX, &metatileY, metatilesWide, metatileWidth, metatileHeight);
+static CopyTileFunc GetCopyTileFunc(int bitDepth)
+{
+	switch (bitDepth) {
+	case 1:
+		return CopyTile1Bpp;
+	case 4:
+		return CopyTile4Bpp;
+	default:
+		return CopyTile8Bpp;
+	}
+}
+
+static void ConvertTiles(unsigned char *pixels, unsigned char *tiles, bool toTiles, int numTiles, int metatilesWide, int metatileWidth, int metatileHeight, int bitDepth, bool invertColors)
+{
+	int tileRowSize = bitDepth;
+	int tileSize = tileRowSize * 8;
+	int pitch = metatilesWide * metatileWidth * tileRowSize;
+	int *offsets = BuildTileOffsets(numTiles, metatilesWide, metatileWidth, metatileHeight, pitch, tileRowSize);
+	CopyTileFunc copyTile = GetCopyTileFunc(bitDepth);
+
+	for (int i = 0; i < numTiles; i++) {
+		if (toTiles)
+			copyTile(&tiles[i * tileSize], tileRowSize, &pixels[offsets[i]], pitch, invertColors);
+		else
+			copyTile(&pixels[offsets[i]], pitch, &tiles[i * tileSize], tileRowSize, invertColors);
 	}
+
+	free(offsets);
 }
 
 // For untiled, plain images
@@ -224,17 +216,6 @@ static void DecodeAffineTilemap(unsigned char *input, unsigned char *output, uns
     }
 }
 
-#define REVERSE_BIT_ORDER(x) ({ \
-      ((((x) >> 7) & 1) << 0)   \
-    | ((((x) >> 6) & 1) << 1)   \
-    | ((((x) >> 5) & 1) << 2)   \
-    | ((((x) >> 4) & 1) << 3)   \
-    | ((((x) >> 3) & 1) << 4)   \
-    | ((((x) >> 2) & 1) << 5)   \
-    | ((((x) >> 1) & 1) << 6)   \
-    | ((((x) >> 0) & 1) << 7);  \
-})
-
 #define SWAP_BYTES(a, b) ({   \
     unsigned char tmp = *(a); \
     *(a) = *(b);              \
@@ -393,69 +374,46 @@ void ReadTileImage(char *path, int tilesWidth, int metatileWidth, int metatileHe
 
 	int metatilesWide = tilesWidth / metatileWidth;
 
-	switch (image->bitDepth) {
-	case 1:
-		ConvertFromTiles1Bpp(buffer, image->pixels, numTiles, metatilesWide, metatileWidth, metatileHeight, invertColors);
-		break;
-	case 4:
-		ConvertFromTiles4Bpp(buffer, image->pixels, numTiles, metatilesWide, metatileWidth, metatileHeight, invertColors);
-		break;
-	case 8:
-		ConvertFromTiles8Bpp(buffer, image->pixels, numTiles, metatilesWide, metatileWidth, metatileHeight, invertColors);
-		break;
-	}
+	ConvertTiles(image->pixels, buffer, false, numTiles, metatilesWide, metatileWidth, metatileHeight, image->bitDepth, invertColors);
 
 	free(buffer);
 }
 
-void WriteTileImage(char *path, enum NumTilesMode numTilesMode, int numTiles, int metatileWidth, int metatileHeight, struct Image *image, bool invertColors)
+static void CheckTileImageSize(int width, int height, int metatileWidth, int metatileHeight)
 {
-	int tileSize = image->bitDepth * 8;
+	if (width % 8 != 0)
+		FATAL_ERROR("The width in pixels (%d) isn't a multiple of 8.\n", width);
 
-	if (image->width % 8 != 0)
-		FATAL_ERROR("The width in pixels (%d) isn't a multiple of 8.\n", image->width);
+	if (height % 8 != 0)
+		FATAL_ERROR("The height in pixels (%d) isn't a multiple of 8.\n", height);
 
-	if (image->height % 8 != 0)
-		FATAL_ERROR("The height in pixels (%d) isn't a multiple of 8.\n", image->height);
-
-	int tilesWidth = image->width / 8;
-	int tilesHeight = image->height / 8;
+	int tilesWidth = width / 8;
+	int tilesHeight = height / 8;
 
 	if (tilesWidth % metatileWidth != 0)
 		FATAL_ERROR("The width in tiles (%d) isn't a multiple of the specified metatile width (%d)\n", tilesWidth, metatileWidth);
 
 	if (tilesHeight % metatileHeight != 0)
 		FATAL_ERROR("The height in tiles (%d) isn't a multiple of the specified metatile height (%d)\n", tilesHeight, metatileHeight);
+}
 
-	int maxNumTiles = tilesWidth * tilesHeight;
-
+static int GetNumTiles(int numTiles, int maxNumTiles)
+{
 	if (numTiles == 0)
-		numTiles = maxNumTiles;
-	else if (numTiles > maxNumTiles)
+		return maxNumTiles;
+	if (numTiles > maxNumTiles)
 		FATAL_ERROR("The specified number of tiles (%d) is greater than the maximum possible value (%d).\n", numTiles, maxNumTiles);
+	return numTiles;
+}
 
+// Returns how much of the converted tiles to keep, checking that the ones
+// past numTiles are blank.
+static int GetTileDataSize(unsigned char *buffer, enum NumTilesMode numTilesMode, int numTiles, int maxNumTiles, int tileSize)
+{
 	int bufferSize = numTiles * tileSize;
 	int maxBufferSize = maxNumTiles * tileSize;
-	unsigned char *buffer = malloc(maxBufferSize);
-
-	if (buffer == NULL)
-		FATAL_ERROR("Failed to allocate memory for pixels.\n");
-
-	int metatilesWide = tilesWidth / metatileWidth;
-
-	switch (image->bitDepth) {
-	case 1:
-		ConvertToTiles1Bpp(image->pixels, buffer, maxNumTiles, metatilesWide, metatileWidth, metatileHeight, invertColors);
-		break;
-	case 4:
-		ConvertToTiles4Bpp(image->pixels, buffer, maxNumTiles, metatilesWide, metatileWidth, metatileHeight, invertColors);
-		break;
-	case 8:
-		ConvertToTiles8Bpp(image->pixels, buffer, maxNumTiles, metatilesWide, metatileWidth, metatileHeight, invertColors);
-		break;
-	}
-
 	bool zeroPadded = true;
+
 	for (int i = bufferSize; i < maxBufferSize && zeroPadded; i++) {
 		if (buffer[i] != 0)
 		{
@@ -474,11 +432,241 @@ void WriteTileImage(char *path, enum NumTilesMode numTilesMode, int numTiles, in
 		}
 	}
 
-	WriteWholeFile(path, buffer, zeroPadded ? bufferSize : maxBufferSize);
+	return zeroPadded ? bufferSize : maxBufferSize;
+}
+
+unsigned char *EncodeTileImage(enum NumTilesMode numTilesMode, int numTiles, int metatileWidth, int metatileHeight, struct Image *image, bool invertColors, int *size)
+{
+	int tileSize = image->bitDepth * 8;
+
+	CheckTileImageSize(image->width, image->height, metatileWidth, metatileHeight);
+
+	int tilesWidth = image->width / 8;
+	int tilesHeight = image->height / 8;
+	int maxNumTiles = tilesWidth * tilesHeight;
+
+	numTiles = GetNumTiles(numTiles, maxNumTiles);
+
+	unsigned char *buffer = malloc(maxNumTiles * tileSize);
+
+	if (buffer == NULL)
+		FATAL_ERROR("Failed to allocate memory for pixels.\n");
+
+	int metatilesWide = tilesWidth / metatileWidth;
+
+	ConvertTiles(image->pixels, buffer, true, maxNumTiles, metatilesWide, metatileWidth, metatileHeight, image->bitDepth, invertColors);
+
+	*size = GetTileDataSize(buffer, numTilesMode, numTiles, maxNumTiles, tileSize);
+	return buffer;
+}
+
+// Same as EncodeTileImage, but converts the PNG one row of metatiles at a
+// time as it's decoded, so only that many pixel rows are ever held in memory.
+unsigned char *EncodeTileImageRows(enum NumTilesMode numTilesMode, int numTiles, int metatileWidth, int metatileHeight, struct PngRows *rows, int bitDepth, bool invertColors, int *size)
+{
+	int tileRowSize = bitDepth;
+	int tileSize = tileRowSize * 8;
+
+	CheckTileImageSize(rows->width, rows->height, metatileWidth, metatileHeight);
+
+	int tilesWidth = rows->width / 8;
+	int tilesHeight = rows->height / 8;
+	int maxNumTiles = tilesWidth * tilesHeight;
+
+	numTiles = GetNumTiles(numTiles, maxNumTiles);
+
+	unsigned char *buffer = malloc(maxNumTiles * tileSize);
+
+	if (buffer == NULL)
+		FATAL_ERROR("Failed to allocate memory for pixels.\n");
+
+	int metatilesWide = tilesWidth / metatileWidth;
+	int pitch = tilesWidth * tileRowSize;
+	int bandRows = metatileHeight * 8;
+	int bandTiles = tilesWidth * metatileHeight;
+	int srcPitch = (rows->width * rows->bitDepth + 7) / 8;
+
+	// The last row is read at the source bit depth before it's converted.
+	unsigned char *band = malloc((bandRows - 1) * pitch + (srcPitch > pitch ? srcPitch : pitch));
+
+	if (band == NULL)
+		FATAL_ERROR("Failed to allocate memory for pixels.\n");
+
+	int *offsets = BuildTileOffsets(bandTiles, metatilesWide, metatileWidth, metatileHeight, pitch, tileRowSize);
+	CopyTileFunc copyTile = GetCopyTileFunc(bitDepth);
+
+	for (int tile = 0; tile < maxNumTiles; tile += bandTiles) {
+		ReadPngRows(rows, band, bandRows, bitDepth);
+
+		for (int i = 0; i < bandTiles; i++)
+			copyTile(&buffer[(tile + i) * tileSize], tileRowSize, &band[offsets[i]], pitch, invertColors);
+	}
+
+	free(offsets);
+	free(band);
+
+	*size = GetTileDataSize(buffer, numTilesMode, numTiles, maxNumTiles, tileSize);
+	return buffer;
+}
+
+void WriteTileImage(char *path, enum NumTilesMode numTilesMode, int numTiles, int metatileWidth, int metatileHeight, struct Image *image, bool invertColors)
+{
+	int bufferSize;
+	unsigned char *buffer = EncodeTileImage(numTilesMode, numTiles, metatileWidth, metatileHeight, image, invertColors, &bufferSize);
+
+	WriteWholeFile(path, buffer, bufferSize);
 
 	free(buffer);
 }
 
+static uint32_t HashTile(unsigned char *tile, int tileSize)
+{
+	uint32_t hash = 2166136261u; // FNV-1a
+
+	for (int i = 0; i < tileSize; i++) {
+		hash ^= tile[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+// Returns the index of the unique tile equal to tile, or -1.
+static int FindTile(unsigned char *tile, unsigned char *uniqueTiles, int tileSize, int *hashTable, int hashMask)
+{
+	for (int slot = HashTile(tile, tileSize) & hashMask; hashTable[slot] >= 0; slot = (slot + 1) & hashMask) {
+		if (memcmp(&uniqueTiles[hashTable[slot] * tileSize], tile, tileSize) == 0)
+			return hashTable[slot];
+	}
+
+	return -1;
+}
+
+// Encodes an image whose pixels are 8 bits each as a tileset of the given
+// bit depth with duplicate tiles removed, plus a non-affine tilemap that
+// rebuilds the original. Tiles that match a stored tile when flipped
+// horizontally and/or vertically are reused with the flip bits set. For 4bpp
+// output, the high nybble of each pixel selects the tile's palette bank.
+unsigned char *EncodeDedupedTileImage(int bitDepth, int metatileWidth, int metatileHeight, struct Image *image, bool invertColors, int *size, unsigned char **tilemap_p, int *tilemapSize)
+{
+	if (bitDepth != 4 && bitDepth != 8)
+		FATAL_ERROR("Tilemaps can only be generated for 4bpp and 8bpp tiles.\n");
+
+	int numPixels = image->width * image->height;
+	struct Image tileImage = *image;
+
+	tileImage.bitDepth = bitDepth;
+
+	if (bitDepth == 4) {
+		tileImage.pixels = calloc(numPixels / 2 + 1, 1);
+
+		if (tileImage.pixels == NULL)
+			FATAL_ERROR("Failed to allocate memory for pixels.\n");
+
+		for (int i = 0; i < numPixels; i++)
+			tileImage.pixels[i / 2] |= (image->pixels[i] & 0xF) << ((i & 1) ? 0 : 4);
+	}
+
+	int tilesSize;
+	unsigned char *tiles = EncodeTileImage(NUM_TILES_IGNORE, 0, metatileWidth, metatileHeight, &tileImage, invertColors, &tilesSize);
+	int tileSize = bitDepth * 8;
+	int numTiles = tilesSize / tileSize;
+	int metatilesWide = image->width / 8 / metatileWidth;
+	int *offsets = BuildTileOffsets(numTiles, metatilesWide, metatileWidth, metatileHeight, image->width, 8);
+
+	if (bitDepth == 4)
+		free(tileImage.pixels);
+
+	int hashSize = 1;
+	while (hashSize < numTiles * 2)
+		hashSize *= 2;
+
+	int *hashTable = malloc(hashSize * sizeof(int));
+	unsigned char *uniqueTiles = malloc(tilesSize);
+	unsigned char *tilemap = malloc(numTiles * 2);
+
+	if (hashTable == NULL || uniqueTiles == NULL || tilemap == NULL)
+		FATAL_ERROR("Failed to allocate memory for tilemap.\n");
+
+	for (int i = 0; i < hashSize; i++)
+		hashTable[i] = -1;
+
+	int numUniqueTiles = 0;
+	unsigned char flipped[64];
+
+	for (int i = 0; i < numTiles; i++) {
+		unsigned char *tile = &tiles[i * tileSize];
+		int palno = 0;
+
+		if (bitDepth == 4 && image->hasPalette) {
+			palno = -1;
+
+			// Color 0 is transparent in every bank, so it doesn't pick one.
+			for (int y = 0; y < 8; y++) {
+				for (int x = 0; x < 8; x++) {
+					unsigned char pixel = image->pixels[offsets[i] + y * image->width + x];
+
+					if ((pixel & 0xF) == 0)
+						continue;
+					if (palno >= 0 && (pixel >> 4) != palno)
+						FATAL_ERROR("Tile %d uses colors from more than one palette.\n", i);
+					palno = pixel >> 4;
+				}
+			}
+
+			if (palno < 0)
+				palno = 0;
+		}
+
+		// Try the tile as-is, then flipped horizontally, vertically and both.
+		int index = -1;
+		int flip;
+
+		memcpy(flipped, tile, tileSize);
+
+		for (flip = 0; flip < 4; flip++) {
+			if (flip != 0)
+				HflipTile(flipped, bitDepth);
+			if (flip == 2)
+				VflipTile(flipped, bitDepth);
+
+			index = FindTile(flipped, uniqueTiles, tileSize, hashTable, hashSize - 1);
+			if (index >= 0)
+				break;
+		}
+
+		if (index < 0) {
+			int slot = HashTile(tile, tileSize) & (hashSize - 1);
+
+			while (hashTable[slot] >= 0)
+				slot = (slot + 1) & (hashSize - 1);
+
+			index = numUniqueTiles++;
+			hashTable[slot] = index;
+			memcpy(&uniqueTiles[index * tileSize], tile, tileSize);
+			flip = 0;
+		}
+
+		if (index > 0x3FF)
+			FATAL_ERROR("The image has more than 1024 unique tiles.\n");
+
+		// flip 1 is horizontal, 2 is vertical, 3 is both: the same order as the tilemap bits.
+		int entry = index | (flip << 10) | (palno << 12);
+
+		tilemap[i * 2] = entry;
+		tilemap[i * 2 + 1] = entry >> 8;
+	}
+
+	free(hashTable);
+	free(offsets);
+	free(tiles);
+
+	*size = numUniqueTiles * tileSize;
+	*tilemap_p = tilemap;
+	*tilemapSize = numTiles * 2;
+	return uniqueTiles;
+}
+
 void ReadPlainImage(char *path, int dataWidth, struct Image *image, bool invertColors)
 {
 	int fileSize;
@@ -505,7 +693,7 @@ void ReadPlainImage(char *path, int dataWidth, struct Image *image, bool invertC
 	free(buffer);
 }
 
-void WritePlainImage(char *path, int dataWidth, struct Image *image, bool invertColors)
+unsigned char *EncodePlainImage(int dataWidth, struct Image *image, bool invertColors, int *size)
 {
 	int bufferSize = image->width * image->height * image->bitDepth / 8;
 
@@ -525,6 +713,15 @@ void WritePlainImage(char *path, int dataWidth, struct Image *image, bool invert
 
 	CopyPlainPixels(image->pixels, buffer, bufferSize, dataWidth, invertColors);
 
+	*size = bufferSize;
+	return buffer;
+}
+
+void WritePlainImage(char *path, int dataWidth, struct Image *image, bool invertColors)
+{
+	int bufferSize;
+	unsigned char *buffer = EncodePlainImage(dataWidth, image, invertColors, &bufferSize);
+
 	WriteWholeFile(path, buffer, bufferSize);
 
 	free(buffer);
@@ -567,12 +764,12 @@ void ReadGbaPalette(char *path, struct Palette *palette)
 	free(data);
 }
 
-void WriteGbaPalette(char *path, struct Palette *palette)
+unsigned char *EncodeGbaPalette(struct Palette *palette, int *size)
 {
-	FILE *fp = fopen(path, "wb");
+	unsigned char *buffer = malloc(palette->numColors * 2 + 1);
 
-	if (fp == NULL)
-		FATAL_ERROR("Failed to open \"%s\" for writing.\n", path);
+	if (buffer == NULL)
+		FATAL_ERROR("Failed to allocate memory for palette.\n");
 
 	for (int i = 0; i < palette->numColors; i++) {
 		unsigned char red = DOWNCONVERT_BIT_DEPTH(palette->colors[i].red);
@@ -581,9 +778,20 @@ void WriteGbaPalette(char *path, struct Palette *palette)
 
 		uint16_t paletteEntry = SET_GBA_PAL(red, green, blue);
 
-		fputc(paletteEntry & 0xFF, fp);
-		fputc(paletteEntry >> 8, fp);
+		buffer[i * 2] = paletteEntry & 0xFF;
+		buffer[i * 2 + 1] = paletteEntry >> 8;
 	}
 
-	fclose(fp);
+	*size = palette->numColors * 2;
+	return buffer;
+}
+
+void WriteGbaPalette(char *path, struct Palette *palette)
+{
+	int size;
+	unsigned char *buffer = EncodeGbaPalette(palette, &size);
+
+	WriteWholeFile(path, buffer, size);
+
+	free(buffer);
 }
@@ -50,12 +50,19 @@ enum NumTilesMode {
     NUM_TILES_ERROR,
 };
 
+struct PngRows;
+
 void ReadTileImage(char *path, int tilesWidth, int metatileWidth, int metatileHeight, struct Image *image, bool invertColors);
+unsigned char *EncodeTileImage(enum NumTilesMode numTilesMode, int numTiles, int metatileWidth, int metatileHeight, struct Image *image, bool invertColors, int *size);
+unsigned char *EncodeTileImageRows(enum NumTilesMode numTilesMode, int numTiles, int metatileWidth, int metatileHeight, struct PngRows *rows, int bitDepth, bool invertColors, int *size);
+unsigned char *EncodeDedupedTileImage(int bitDepth, int metatileWidth, int metatileHeight, struct Image *image, bool invertColors, int *size, unsigned char **tilemap_p, int *tilemapSize);
 void WriteTileImage(char *path, enum NumTilesMode numTilesMode, int numTiles, int metatileWidth, int metatileHeight, struct Image *image, bool invertColors);
 void ReadPlainImage(char *path, int dataWidth, struct Image *image, bool invertColors);
+unsigned char *EncodePlainImage(int dataWidth, struct Image *image, bool invertColors, int *size);
 void WritePlainImage(char *path, int dataWidth, struct Image *image, bool invertColors);
 void FreeImage(struct Image *image);
 void ReadGbaPalette(char *path, struct Palette *palette);
+unsigned char *EncodeGbaPalette(struct Palette *palette, int *size);
 void WriteGbaPalette(char *path, struct Palette *palette);
 
 #endif // GFX_H
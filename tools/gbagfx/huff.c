@@ -6,172 +6,274 @@
 #include "global.h"
 #include "huff.h"
 
-static int cmp_tree(const void * a0, const void * b0) {
-    return ((struct HuffData *)a0)->value - ((struct HuffData *)b0)->value;
+static int cmp_leaves(const void * a0, const void * b0) {
+    const struct HuffNode * a = a0;
+    const struct HuffNode * b = b0;
+
+    if (a->weight != b->weight)
+        return a->weight < b->weight ? -1 : 1;
+    return a->symbol - b->symbol;
 }
 
-typedef int (*cmpfun)(const void *, const void *);
+static int cmp_codes(const void * a0, const void * b0) {
+    const struct HuffNode * a = a0;
+    const struct HuffNode * b = b0;
+
+    // Leaves carry their code length in `weight` once lengths are assigned.
+    if (a->weight != b->weight)
+        return a->weight < b->weight ? -1 : 1;
+    return a->symbol - b->symbol;
+}
 
-int msort_r(void * data, size_t count, size_t size, cmpfun cmp, void * buffer) {
+static void build_code_lengths(struct HuffNode * leaves, int nleaves, int * counts) {
     /*
-     * Out-of-place mergesort (stable sort)
-     * Returns 1 on success, 0 on failure
+     * Two-queue Huffman construction.  The leaves are already sorted by
+     * weight, and merged nodes are created in non-decreasing weight order,
+     * so the two smallest nodes are always at the front of one of the queues.
+     * Fills counts[len] with the number of leaves at each depth.
      */
-    void * leftPtr;
-    void * rightPtr;
-    void * leftEnd;
-    void * rightEnd;
-    int i;
-
-    switch (count) {
-    case 0:
-        // Should never be here
-        return 0;
+    int nnodes = 2 * nleaves - 1;
+    unsigned int * weight = malloc(nnodes * sizeof(unsigned int));
+    int * parent = malloc(nnodes * sizeof(int));
+    int * depth = malloc(nnodes * sizeof(int));
 
-    case 1:
-        // Nothing to do here
-        break;
+    if (weight == NULL || parent == NULL || depth == NULL)
+        FATAL_ERROR("Fatal error while compressing Huff file.\n");
 
-    case 2:
-        // Swap the two entries if the right one compares higher.
-        if (cmp(data, data + size) > 0) {
-            memcpy(buffer, data, size);
-            memcpy(data, data + size, size);
-            memcpy(data + size, buffer, size);
-        }
-        break;
-    default:
-        // Merge sort out-of-place.
-        leftPtr = data;
-        leftEnd = rightPtr = data + count / 2 * size;
-        rightEnd = data + count * size;
-
-        // Sort the left half
-        if (!msort_r(leftPtr, count / 2, size, cmp, buffer))
-            return 0;
-
-        // Sort the right half
-        if (!msort_r(rightPtr, count / 2 + (count & 1), size, cmp, buffer))
-            return 0;
-
-        // Merge the sorted halves out of place
-        i = 0;
-        do {
-            if (cmp(leftPtr, rightPtr) <= 0) {
-                memcpy(buffer + i * size, leftPtr, size);
-                leftPtr += size;
-            } else {
-                memcpy(buffer + i * size, rightPtr, size);
-                rightPtr += size;
-            }
+    for (int i = 0; i < nleaves; i++)
+        weight[i] = leaves[i].weight;
 
-        } while (++i < count && leftPtr < leftEnd && rightPtr < rightEnd);
+    int leafPos = 0;
+    int branchPos = nleaves;
 
-        // Copy the remainder
-        if (i < count) {
-            if (leftPtr < leftEnd) {
-                memcpy(buffer + i * size, leftPtr, leftEnd - leftPtr);
-            }
-            else {
-                memcpy(buffer + i * size, rightPtr, rightEnd - rightPtr);
-            }
+    for (int i = nleaves; i < nnodes; i++) {
+        int pick[2];
+
+        for (int j = 0; j < 2; j++) {
+            if (leafPos < nleaves && (branchPos == i || weight[leafPos] <= weight[branchPos]))
+                pick[j] = leafPos++;
+            else
+                pick[j] = branchPos++;
         }
 
-        // Copy the merged data back
-        memcpy(data, buffer, count * size);
-        break;
+        weight[i] = weight[pick[0]] + weight[pick[1]];
+        parent[pick[0]] = i;
+        parent[pick[1]] = i;
     }
 
-    return 1;
-}
+    // Children always have lower indices than their parents.
+    depth[nnodes - 1] = 0;
+    for (int i = nnodes - 2; i >= 0; i--)
+        depth[i] = depth[parent[i]] + 1;
+
+    for (int i = 0; i < nleaves; i++)
+        counts[depth[i]]++;
 
-int msort(void * data, size_t count, size_t size, cmpfun cmp) {
-    void * buffer = malloc(count * size);
-    if (buffer == NULL) return 0;
-    int result = msort_r(data, count, size, cmp, buffer);
-    free(buffer);
-    return result;
+    free(depth);
+    free(parent);
+    free(weight);
 }
 
-static void write_tree(unsigned char * dest, HuffNode_t * tree, int nitems, struct BitEncoding * encoding) {
+static void limit_code_lengths(int * counts, int maxDepth, int maxLength) {
     /*
-     * The example used to guide this function encodes the tree in a
-     * breadth-first manner.  We attempt to emulate that here.
+     * Push leaves deeper than maxLength up the tree while keeping the set of
+     * lengths complete (the procedure from JPEG Annex K.3): two leaves at the
+     * deepest level are replaced by one, and a shallower leaf is split into two.
      */
+    for (int i = maxDepth; i > maxLength; i--) {
+        while (counts[i] > 0) {
+            int j = i - 2;
 
-    int i, j, k;
+            while (counts[j] == 0)
+                j--;
+
+            counts[i] -= 2;
+            counts[i - 1]++;
+            counts[j + 1] += 2;
+            counts[j]--;
+        }
+    }
+}
 
-    // There are (2 * nitems - 1) nodes in the binary tree.  Allocate that.
-    HuffNode_t * traversal = calloc(2 * nitems - 1, sizeof(HuffNode_t));
-    if (traversal == NULL)
+static int new_node(struct HuffNode * nodes, int * nnodes) {
+    struct HuffNode * node = &nodes[*nnodes];
+    node->weight = 0;
+    node->child[0] = -1;
+    node->child[1] = -1;
+    node->symbol = -1;
+    node->numBranches = 0;
+    return (*nnodes)++;
+}
+
+static int count_branches(struct HuffNode * nodes, int node) {
+    if (nodes[node].child[0] < 0)
+        return 0;
+    nodes[node].numBranches = 1 + count_branches(nodes, nodes[node].child[0]) + count_branches(nodes, nodes[node].child[1]);
+    return nodes[node].numBranches;
+}
+
+static void write_tree(unsigned char * dest, struct HuffNode * nodes, int root, int nleaves) {
+    /*
+     * Lay the tree out as GBA node pairs.  Every branch stores a 6-bit offset
+     * to its pair of children, so a child pair must land within 64 pairs of
+     * the pair holding its parent.  Pending branches are kept in the order
+     * they were written; whenever the earliest deadlines leave no slack they
+     * are served first, otherwise the branch with the smallest subtree is
+     * expanded so the set of pending branches stays small.
+     */
+    unsigned char * table = dest + 5;
+    int * pendNode = malloc(nleaves * sizeof(int));
+    int * pendSlot = malloc(nleaves * sizeof(int));
+    int * pendPair = malloc(nleaves * sizeof(int));
+    int npending = 0;
+
+    if (pendNode == NULL || pendSlot == NULL || pendPair == NULL)
         FATAL_ERROR("Fatal error while compressing Huff file.\n");
 
-    // The first node is the root of the tree.
-    traversal[0] = *tree;
-    i = 1;
-
-    // Copy the tree into a breadth-first ordering using brute force.
-    for (int depth = 1; i < 2 * nitems - 1; depth++) {
-        // Consider every possible path up to the current depth.
-        for (j = 0; i < 2 * nitems - 1 && j < 1 << depth; j++) {
-            // The index of the path is used to encode the path itself.
-            // Start from the most significant relevant bit and work our way down.
-            // Keep track of the current and previous nodes.
-            HuffNode_t * currNode = traversal;
-            HuffNode_t * parent = NULL;
-            for (k = 0; k < depth; k++) {
-                if (currNode->header.isLeaf)
-                    break;
-                parent = currNode;
-                if ((j >> (depth - k - 1)) & 1)
-                    currNode = currNode->branch.right;
-                else
-                    currNode = currNode->branch.left;
+    pendNode[0] = root;
+    pendSlot[0] = 0;
+    pendPair[0] = -1;
+    npending = 1;
+
+    for (int pair = 0; pair < nleaves - 1; pair++) {
+        int pick = -1;
+
+        for (int i = 0; i < npending; i++) {
+            int slack = pendPair[i] + 1 + HUFF_MAX_NODE_OFFSET - pair - i;
+            if (slack < 0)
+                FATAL_ERROR("Fatal error while compressing Huff file: unable to encode binary tree.\n");
+            if (slack == 0) {
+                pick = 0;
+                break;
             }
-            // Check that the length of the current path equals the current depth.
-            if (k == depth) {
-                // Make sure we can encode the current branch.
-                // Bail here if we cannot.
-                // This is only applicable for 8-bit encodings.
-                if (traversal + i - parent > 128)
-                    FATAL_ERROR("Fatal error while compressing Huff file: unable to encode binary tree.\n");
-                // Copy the current node, and update its parent.
-                traversal[i] = *currNode;
-                if (parent != NULL) {
-                    if ((j & 1) == 1)
-                        parent->branch.right = traversal + i;
-                    else
-                        parent->branch.left = traversal + i;
-                }
-                // Encode the path through the tree in the lookup table
-                if (traversal[i].header.isLeaf) {
-                    encoding[traversal[i].leaf.key].nbits = depth;
-                    encoding[traversal[i].leaf.key].bitstring = j;
-                }
-                i++;
+        }
+
+        if (pick < 0) {
+            pick = 0;
+            for (int i = 1; i < npending; i++) {
+                if (nodes[pendNode[i]].numBranches < nodes[pendNode[pick]].numBranches)
+                    pick = i;
+            }
+        }
+
+        int node = pendNode[pick];
+        int slot = pendSlot[pick];
+        int offset = pair - pendPair[pick] - 1;
+
+        npending--;
+        memmove(&pendNode[pick], &pendNode[pick + 1], (npending - pick) * sizeof(int));
+        memmove(&pendSlot[pick], &pendSlot[pick + 1], (npending - pick) * sizeof(int));
+        memmove(&pendPair[pick], &pendPair[pick + 1], (npending - pick) * sizeof(int));
+
+        table[slot] = offset;
+
+        for (int i = 0; i < 2; i++) {
+            int child = nodes[node].child[i];
+            int childSlot = 2 * pair + 1 + i;
+
+            if (nodes[child].child[0] < 0) {
+                table[childSlot] = nodes[child].symbol;
+                table[slot] |= 0x80 >> i;
+            } else {
+                pendNode[npending] = child;
+                pendSlot[npending] = childSlot;
+                pendPair[npending] = pair;
+                npending++;
             }
         }
     }
 
     // Encode the size of the tree.
     // This is used by the decompressor to skip the tree.
-    dest[4] = nitems - 1;
+    dest[4] = nleaves - 1;
 
-    // Encode each node in the tree.
-    for (i = 0; i < 2 * nitems - 1; i++) {
-        HuffNode_t * currNode = traversal + i;
-        if (currNode->header.isLeaf) {
-            dest[5 + i] = traversal[i].leaf.key;
-        } else {
-            dest[5 + i] = (((currNode->branch.right - traversal - i) / 2) - 1);
-            if (currNode->branch.left->header.isLeaf)
-                dest[5 + i] |= 0x80;
-            if (currNode->branch.right->header.isLeaf)
-                dest[5 + i] |= 0x40;
+    free(pendPair);
+    free(pendSlot);
+    free(pendNode);
+}
+
+static int build_tree(unsigned char * dest, unsigned int * freqs, int nitems, struct BitEncoding * encoding) {
+    /*
+     * Builds a length-limited Huffman code for the used symbols, turns it into
+     * a canonical tree and writes that tree to dest.  Returns the number of leaves.
+     */
+    struct HuffNode * leaves = calloc(nitems + 1, sizeof(struct HuffNode));
+    struct HuffNode * nodes = calloc(2 * nitems + 1, sizeof(struct HuffNode));
+    int * counts = calloc(2 * nitems + 1, sizeof(int));
+    int nleaves = 0;
+    int nnodes = 0;
+
+    if (leaves == NULL || nodes == NULL || counts == NULL)
+        FATAL_ERROR("Fatal error while compressing Huff file.\n");
+
+    for (int i = 0; i < nitems; i++) {
+        if (freqs[i] != 0) {
+            leaves[nleaves].weight = freqs[i];
+            leaves[nleaves].symbol = i;
+            nleaves++;
+        }
+    }
+
+    // The root of a GBA tree can't be a leaf, so give a lone symbol an unused sibling.
+    if (nleaves == 1) {
+        leaves[1].weight = 0;
+        leaves[1].symbol = (leaves[0].symbol + 1) % nitems;
+        nleaves = 2;
+    }
+
+    qsort(leaves, nleaves, sizeof(struct HuffNode), cmp_leaves);
+
+    build_code_lengths(leaves, nleaves, counts);
+    limit_code_lengths(counts, nleaves - 1, HUFF_MAX_CODE_LENGTH);
+
+    // Hand the shortest codes to the most frequent symbols.
+    int length = 1;
+    for (int i = nleaves - 1; i >= 0; i--) {
+        while (counts[length] == 0)
+            length++;
+        counts[length]--;
+        leaves[i].weight = length;
+    }
+
+    // Assign canonical codes and build the matching tree.
+    qsort(leaves, nleaves, sizeof(struct HuffNode), cmp_codes);
+
+    int root = new_node(nodes, &nnodes);
+    uint32_t code = 0;
+    unsigned prevLength = leaves[0].weight;
+
+    for (int i = 0; i < nleaves; i++) {
+        unsigned nbits = leaves[i].weight;
+        int node = root;
+
+        code <<= nbits - prevLength;
+        prevLength = nbits;
+
+        encoding[leaves[i].symbol].nbits = nbits;
+        encoding[leaves[i].symbol].bitstring = code;
+
+        for (int bit = nbits - 1; bit >= 0; bit--) {
+            int dir = (code >> bit) & 1;
+
+            if (nodes[node].child[dir] < 0) {
+                int child = new_node(nodes, &nnodes);
+                nodes[node].child[dir] = child;
+            }
+            node = nodes[node].child[dir];
         }
+
+        nodes[node].symbol = leaves[i].symbol;
+        code++;
     }
 
-    free(traversal);
+    count_branches(nodes, root);
+    write_tree(dest, nodes, root, nleaves);
+
+    free(counts);
+    free(nodes);
+    free(leaves);
+
+    return nleaves;
 }
 
 static inline void write_32_le(unsigned char * dest, int * destPos, uint32_t * buff, int * buffPos) {
@@ -184,13 +286,12 @@ static inline void write_32_le(unsigned char * dest, int * destPos, uint32_t * b
     *buffPos = 0;
 }
 
-static inline void read_32_le(unsigned char * src, int * srcPos, uint32_t * buff) {
-    uint32_t tmp = src[*srcPos];
-    tmp |= src[*srcPos + 1] << 8;
-    tmp |= src[*srcPos + 2] << 16;
-    tmp |= src[*srcPos + 3] << 24;
-    *srcPos += 4;
-    *buff = tmp;
+static inline uint32_t read_32_le(unsigned char * src, int srcPos) {
+    uint32_t tmp = src[srcPos];
+    tmp |= src[srcPos + 1] << 8;
+    tmp |= src[srcPos + 2] << 16;
+    tmp |= (uint32_t)src[srcPos + 3] << 24;
+    return tmp;
 }
 
 static void write_bits(unsigned char * dest, int * destPos, struct BitEncoding * encoding, int value, uint32_t * buff, int * buffBits) {
@@ -201,7 +302,7 @@ static void write_bits(unsigned char * dest, int * destPos, struct BitEncoding *
         int diff = *buffBits + nbits - 32;
         *buff <<= nbits - diff;
         *buff |= bitstring >> diff;
-        bitstring &= ~(1 << diff);
+        bitstring &= (1u << diff) - 1;
         nbits = diff;
         write_32_le(dest, destPos, buff, buffBits);
     }
@@ -212,6 +313,40 @@ static void write_bits(unsigned char * dest, int * destPos, struct BitEncoding *
     }
 }
 
+static void build_lookup(unsigned char * src, int treeEnd, struct HuffLookup * lookup) {
+    /*
+     * For every HUFF_LOOKUP_BITS-bit prefix of the stream, walk the tree once
+     * and remember either the symbol reached (and how many bits it took) or
+     * the node the walk ended on, so decoding can resume there.
+     */
+    for (int prefix = 0; prefix < (1 << HUFF_LOOKUP_BITS); prefix++) {
+        int treePos = 5;
+
+        lookup[prefix].isLeaf = 0;
+        lookup[prefix].length = HUFF_LOOKUP_BITS;
+
+        for (int i = 0; i < HUFF_LOOKUP_BITS; i++) {
+            int curBit = (prefix >> (HUFF_LOOKUP_BITS - 1 - i)) & 1;
+            unsigned char treeView = src[treePos];
+            bool isLeaf = ((treeView << curBit) & 0x80) != 0;
+
+            treePos &= ~1; // align
+            treePos += ((treeView & 0x3F) + 1) * 2 + curBit;
+            if (treePos >= treeEnd)
+                FATAL_ERROR("Fatal error while decompressing Huff file.\n");
+
+            if (isLeaf) {
+                lookup[prefix].isLeaf = 1;
+                lookup[prefix].length = i + 1;
+                treePos = src[treePos];
+                break;
+            }
+        }
+
+        lookup[prefix].value = treePos;
+    }
+}
+
 /*
 =======================================
 MAIN COMPRESSION/DECOMPRESSION ROUTINES
@@ -222,15 +357,15 @@ unsigned char * HuffCompress(unsigned char * src, int srcSize, int * compressedS
     if (srcSize <= 0)
         goto fail;
 
-    int worstCaseDestSize = 4 + (2 << bitDepth) + srcSize * 3;
+    int nitems = 1 << bitDepth;
+    int numSymbols = ((srcSize + 3) & ~3) * (8 / bitDepth);
+    int worstCaseDestSize = 4 + 2 * nitems + ((numSymbols * HUFF_MAX_CODE_LENGTH + 31) / 32) * 4;
 
-    unsigned char *dest = malloc(worstCaseDestSize);
+    unsigned char *dest = calloc(worstCaseDestSize, 1);
     if (dest == NULL)
         goto fail;
 
-    int nitems = 1 << bitDepth;
-
-    HuffNode_t * freqs = calloc(nitems, sizeof(HuffNode_t));
+    unsigned int * freqs = calloc(nitems, sizeof(unsigned int));
     if (freqs == NULL)
         goto fail;
 
@@ -238,93 +373,52 @@ unsigned char * HuffCompress(unsigned char * src, int srcSize, int * compressedS
     if (encoding == NULL)
         goto fail;
 
-    // Set up the frequencies table.  This will inform the tree.
-    for (int i = 0; i < nitems; i++) {
-        freqs[i].header.isLeaf = 1;
-        freqs[i].header.value = 0;
-        freqs[i].leaf.key = i;
-    }
+    // The decompressor writes whole words, so the stream has to cover the
+    // last word of the output too.  Pad it with zeros.
+    int paddedSize = (srcSize + 3) & ~3;
 
     // Count each nybble or byte.
-    for (int i = 0; i < srcSize; i++) {
+    for (int i = 0; i < paddedSize; i++) {
+        unsigned char value = i < srcSize ? src[i] : 0;
+
         if (bitDepth == 8) {
-            freqs[src[i]].header.value++;
+            freqs[value]++;
         } else {
-            freqs[src[i] >> 4].header.value++;
-            freqs[src[i] & 0xF].header.value++;
+            freqs[value >> 4]++;
+            freqs[value & 0xF]++;
         }
     }
 
 #ifdef DEBUG
     for (int i = 0; i < nitems; i++) {
-        fprintf(stderr, "%d: %d\n", i, freqs[i].header.value);
+        fprintf(stderr, "%d: %d\n", i, freqs[i]);
     }
 #endif // DEBUG
 
-    // Sort the frequency table.
-    if (!msort(freqs, nitems, sizeof(HuffNode_t), cmp_tree))
-        goto fail;
-
-    // Prune zero-frequency values.
-    for (int i = 0; i < nitems; i++) {
-        if (freqs[i].header.value != 0) {
-            if (i > 0) {
-                for (int j = i; j < nitems; j++) {
-                    freqs[j - i] = freqs[j];
-                }
-                nitems -= i;
-            }
-            break;
-        }
-        // This should never happen:
-        if (i == nitems - 1)
-            goto fail;
-    }
+    // Write the tree, and create the path lookup table.
+    int nleaves = build_tree(dest, freqs, nitems, encoding);
 
-    HuffNode_t * tree = calloc(nitems * 2 - 1, sizeof(HuffNode_t));
-    if (tree == NULL)
-        goto fail;
-
-    // Iteratively collapse the two least frequent nodes.
-    HuffNode_t * endptr = freqs + nitems - 2;
-
-    for (int i = 0; i < nitems - 1; i++) {
-        HuffNode_t * left = freqs;
-        HuffNode_t * right = freqs + 1;
-        tree[i * 2] = *right;
-        tree[i * 2 + 1] = *left;
-        for (int j = 0; j < nitems - i - 2; j++)
-            freqs[j] = freqs[j + 2];
-        endptr->header.isLeaf = 0;
-        endptr->header.value = tree[i * 2].header.value + tree[i * 2 + 1].header.value;
-        endptr->branch.left = tree + i * 2;
-        endptr->branch.right = tree + i * 2 + 1;
-        endptr--;
-        if (i < nitems - 2 && !msort(freqs, nitems - i - 1, sizeof(HuffNode_t), cmp_tree))
-            goto fail;
-    }
-
-    // Write the tree breadth-first, and create the path lookup table.
-    write_tree(dest, freqs, nitems, encoding);
-
-    free(tree);
     free(freqs);
 
     // Encode the data itself.
-    int destPos = 4 + nitems * 2;
+    int destPos = 4 + nleaves * 2;
     uint32_t destBuf = 0;
-    uint32_t srcBuf = 0;
     int destBitPos = 0;
 
-    for (int srcPos = 0; srcPos < srcSize;) {
-        read_32_le(src, &srcPos, &srcBuf);
-        for (int i = 0; i < 32 / bitDepth; i++) {
-            write_bits(dest, &destPos, encoding, srcBuf & (0xFF >> (8 - bitDepth)), &destBuf, &destBitPos);
-            srcBuf >>= bitDepth;
+    for (int srcPos = 0; srcPos < paddedSize; srcPos++) {
+        unsigned char value = srcPos < srcSize ? src[srcPos] : 0;
+
+        if (bitDepth == 8) {
+            write_bits(dest, &destPos, encoding, value, &destBuf, &destBitPos);
+        } else {
+            write_bits(dest, &destPos, encoding, value & 0xF, &destBuf, &destBitPos);
+            write_bits(dest, &destPos, encoding, value >> 4, &destBuf, &destBitPos);
         }
     }
 
     if (destBitPos != 0) {
+        // The stream is read starting from bit 31, so left-align the last word.
+        destBuf <<= 32 - destBitPos;
         write_32_le(dest, &destPos, &destBuf, &destBitPos);
     }
 
@@ -343,7 +437,7 @@ fail:
 }
 
 unsigned char * HuffDecompress(unsigned char * src, int srcSize, int * uncompressedSize_p) {
-    if (srcSize < 4)
+    if (srcSize < 5)
         goto fail;
 
     int bitDepth = *src & 15;
@@ -352,47 +446,83 @@ unsigned char * HuffDecompress(unsigned char * src, int srcSize, int * uncompres
 
     int destSize = (src[3] << 16) | (src[2] << 8) | src[1];
 
-    unsigned char *dest = malloc(destSize);
+    unsigned char *dest = calloc(destSize + 1, 1);
 
     if (dest == NULL)
         goto fail;
 
-    int treePos = 5;
     int treeSize = (src[4] + 1) * 2;
     int srcPos = 4 + treeSize;
-    int destPos = 0;
-    int curValPos = 0;
-    uint32_t destTmp = 0;
-    uint32_t window;
-
-    for (;;)
-    {
-        if (srcPos >= srcSize)
+
+    if (srcPos > srcSize)
+        goto fail;
+
+    struct HuffLookup lookup[1 << HUFF_LOOKUP_BITS];
+    build_lookup(src, srcPos, lookup);
+
+    int numSymbols = destSize * (8 / bitDepth);
+    uint64_t window = 0;
+    int windowBits = 0;
+
+    for (int i = 0; i < numSymbols; i++) {
+        // Keep at least one whole lookup (and usually a full code) buffered.
+        while (windowBits <= 32 && srcPos + 4 <= srcSize) {
+            window |= (uint64_t)read_32_le(src, srcPos) << (32 - windowBits);
+            windowBits += 32;
+            srcPos += 4;
+        }
+
+        struct HuffLookup entry = lookup[window >> (64 - HUFF_LOOKUP_BITS)];
+        int symbol;
+
+        if (entry.length > windowBits)
             goto fail;
-        read_32_le(src, &srcPos, &window);
-        for (int i = 0; i < 32; i++) {
-            int curBit = (window >> 31) & 1;
-            unsigned char treeView = src[treePos];
-            bool isLeaf = ((treeView << curBit) & 0x80) != 0;
-            treePos &= ~1; // align
-            treePos += ((treeView & 0x3F) + 1) * 2 + curBit;
-            if (isLeaf) {
-                destTmp >>= bitDepth;
-                destTmp |= (src[treePos] << (32 - bitDepth));
-                curValPos++;
-                if (curValPos == 32 / bitDepth) {
-                    write_32_le(dest, &destPos, &destTmp, &curValPos);
-                    if (destPos == destSize) {
-                        *uncompressedSize_p = destSize;
-                        return dest;
-                    }
+        window <<= entry.length;
+        windowBits -= entry.length;
+
+        if (entry.isLeaf) {
+            symbol = entry.value;
+        } else {
+            // Codes longer than the table: finish the walk one bit at a time.
+            int treePos = entry.value;
+
+            for (;;) {
+                if (windowBits == 0) {
+                    if (srcPos + 4 > srcSize)
+                        goto fail;
+                    window = (uint64_t)read_32_le(src, srcPos) << 32;
+                    windowBits = 32;
+                    srcPos += 4;
+                }
+
+                int curBit = window >> 63;
+                unsigned char treeView = src[treePos];
+                bool isLeaf = ((treeView << curBit) & 0x80) != 0;
+
+                window <<= 1;
+                windowBits--;
+
+                treePos &= ~1; // align
+                treePos += ((treeView & 0x3F) + 1) * 2 + curBit;
+                if (treePos >= 4 + treeSize)
+                    goto fail;
+
+                if (isLeaf) {
+                    symbol = src[treePos];
+                    break;
                 }
-                treePos = 5;
             }
-            window <<= 1;
         }
+
+        if (bitDepth == 8)
+            dest[i] = symbol;
+        else
+            dest[i >> 1] |= (symbol & 0xF) << ((i & 1) * 4);
     }
 
+    *uncompressedSize_p = destSize;
+    return dest;
+
 fail:
     FATAL_ERROR("Fatal error while decompressing Huff file.\n");
 }
@@ -1,35 +1,34 @@
 #ifndef HUFF_H
 #define HUFF_H
 
-union HuffNode;
+#include <stdint.h>
 
-struct HuffData {
-    unsigned value:31;
-    unsigned isLeaf:1;
-};
+// Longest code the compressor will emit.  Keeps every code inside one 32-bit
+// stream word and bounds the decoder's slow path.
+#define HUFF_MAX_CODE_LENGTH 16
 
-struct HuffLeaf {
-    struct HuffData header;
-    unsigned char key;
-};
+// Number of bits resolved by one lookup in the decoder's table.
+#define HUFF_LOOKUP_BITS 8
 
-struct HuffBranch {
-    struct HuffData header;
-    union HuffNode * left;
-    union HuffNode * right;
-};
+// GBA tree nodes can only point up to 64 node pairs ahead of themselves.
+#define HUFF_MAX_NODE_OFFSET 63
 
-union HuffNode {
-    struct HuffData header;
-    struct HuffLeaf leaf;
-    struct HuffBranch branch;
+struct HuffNode {
+    unsigned int weight;
+    int child[2];   // -1 for leaves
+    int symbol;
+    int numBranches; // number of non-leaf nodes in this subtree, including itself
 };
 
-typedef union HuffNode HuffNode_t;
-
 struct BitEncoding {
-    unsigned long long nbits:6;
-    unsigned long long bitstring:58;
+    unsigned nbits;
+    uint32_t bitstring;
+};
+
+struct HuffLookup {
+    unsigned short value;  // the symbol for leaves, otherwise the tree offset to resume from
+    unsigned char length;  // number of bits consumed
+    unsigned char isLeaf;
 };
 
 unsigned char * HuffCompress(unsigned char * buffer, int srcSize, int * compressedSize_p, int bitDepth);
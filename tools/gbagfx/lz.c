@@ -2,6 +2,7 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <pthread.h>
 #include "global.h"
 #include "lz.h"
 
@@ -69,6 +70,119 @@ fail:
 	FATAL_ERROR("Fatal error while decompressing LZ file.\n");
 }
 
+// The search for each position only reads the window before it and the bytes
+// it could match, so positions can be searched in any order.
+static void FindLongestMatch(unsigned char *src, int srcSize, int srcPos, int minDistance, struct LZMatch *match)
+{
+	int bestBlockDistance = 0;
+	int bestBlockSize = 0;
+	int blockDistance = minDistance;
+
+	while (blockDistance <= srcPos && blockDistance <= LZ_WINDOW_SIZE) {
+		int blockStart = srcPos - blockDistance;
+		int blockSize = 0;
+
+		while (blockSize < LZ_MAX_BLOCK_SIZE
+		    && srcPos + blockSize < srcSize
+		    && src[blockStart + blockSize] == src[srcPos + blockSize])
+			blockSize++;
+
+		if (blockSize > bestBlockSize) {
+			bestBlockDistance = blockDistance;
+			bestBlockSize = blockSize;
+
+			if (blockSize == LZ_MAX_BLOCK_SIZE)
+				break;
+		}
+
+		blockDistance++;
+	}
+
+	match->size = bestBlockSize;
+	match->distance = bestBlockDistance;
+}
+
+struct LZSearchJob {
+	unsigned char *src;
+	int srcSize;
+	int start;
+	int end;
+	int minDistance;
+	struct LZMatch *matches;
+};
+
+// Walks the chunk the way the greedy parse would if it started at the
+// chunk's first byte, searching only the positions that walk lands on.
+// The real parse enters the chunk wherever the previous chunk's last block
+// ends. Greedy parses usually fall into step after a few blocks, and the
+// parse searches any position this walk skipped itself.
+static void *SearchMatches(void *arg)
+{
+	struct LZSearchJob *job = arg;
+	int srcPos = job->start;
+
+	while (srcPos < job->end) {
+		struct LZMatch *match = &job->matches[srcPos];
+
+		FindLongestMatch(job->src, job->srcSize, srcPos, job->minDistance, match);
+		srcPos += match->size >= 3 ? match->size : 1;
+	}
+
+	return NULL;
+}
+
+// Finds matches ahead of the parse. Large inputs are split into chunks
+// searched on separate threads; each chunk reads the 0x1000 bytes before
+// its start as its window, so the chunks overlap by one window but write
+// disjoint parts of the match table. Positions that weren't searched are
+// left marked with LZ_MATCH_UNKNOWN.
+static struct LZMatch *FindMatches(unsigned char *src, int srcSize, int minDistance)
+{
+	struct LZMatch *matches = malloc(srcSize * sizeof(struct LZMatch));
+
+	if (matches == NULL)
+		return NULL;
+
+	for (int i = 0; i < srcSize; i++)
+		matches[i].size = LZ_MATCH_UNKNOWN;
+
+	int numThreads = srcSize / LZ_MIN_CHUNK_SIZE;
+
+	if (numThreads < 1)
+		numThreads = 1;
+	if (numThreads > LZ_MAX_THREADS)
+		numThreads = LZ_MAX_THREADS;
+
+	struct LZSearchJob jobs[LZ_MAX_THREADS];
+	pthread_t threads[LZ_MAX_THREADS];
+	bool started[LZ_MAX_THREADS];
+
+	for (int i = 0; i < numThreads; i++) {
+		jobs[i].src = src;
+		jobs[i].srcSize = srcSize;
+		jobs[i].start = (int)((long long)srcSize * i / numThreads);
+		jobs[i].end = (int)((long long)srcSize * (i + 1) / numThreads);
+		jobs[i].minDistance = minDistance;
+		jobs[i].matches = matches;
+	}
+
+	// The first chunk runs on this thread. If a thread can't be started,
+	// its chunk is searched here too.
+	for (int i = 1; i < numThreads; i++)
+		started[i] = pthread_create(&threads[i], NULL, SearchMatches, &jobs[i]) == 0;
+
+	SearchMatches(&jobs[0]);
+
+	for (int i = 1; i < numThreads; i++) {
+		if (started[i])
+			pthread_join(threads[i], NULL);
+		else
+			SearchMatches(&jobs[i]);
+	}
+
+	return matches;
+}
+
 unsigned char *LZCompress(unsigned char *src, int srcSize, int *compressedSize, const int minDistance)
 {
 	if (srcSize <= 0)
@@ -84,6 +198,11 @@ unsigned char *LZCompress(unsigned char *src, int srcSize, int *compressedSize,
 	if (dest == NULL)
 		goto fail;
 
+	struct LZMatch *matches = FindMatches(src, srcSize, minDistance);
+
+	if (matches == NULL)
+		goto fail;
+
 	// header
 	dest[0] = 0x10; // LZ compression type
 	dest[1] = (unsigned char)srcSize;
@@ -93,34 +212,18 @@ unsigned char *LZCompress(unsigned char *src, int srcSize, int *compressedSize,
 	int srcPos = 0;
 	int destPos = 4;
 
+	// Greedy parse over the matches found above. This has to stay sequential,
+	// since where each block starts depends on the blocks before it.
 	for (;;) {
 		unsigned char *flags = &dest[destPos++];
 		*flags = 0;
 
 		for (int i = 0; i < 8; i++) {
-			int bestBlockDistance = 0;
-			int bestBlockSize = 0;
-			int blockDistance = minDistance;
-
-			while (blockDistance <= srcPos && blockDistance <= 0x1000) {
-				int blockStart = srcPos - blockDistance;
-				int blockSize = 0;
+			if (matches[srcPos].size == LZ_MATCH_UNKNOWN)
+				FindLongestMatch(src, srcSize, srcPos, minDistance, &matches[srcPos]);
 
-				while (blockSize < 18
-				    && srcPos + blockSize < srcSize
-				    && src[blockStart + blockSize] == src[srcPos + blockSize])
-					blockSize++;
-
-				if (blockSize > bestBlockSize) {
-					bestBlockDistance = blockDistance;
-					bestBlockSize = blockSize;
-
-					if (blockSize == 18)
-						break;
-				}
-
-				blockDistance++;
-			}
+			int bestBlockSize = matches[srcPos].size;
+			int bestBlockDistance = matches[srcPos].distance;
 
 			if (bestBlockSize >= 3) {
 				*flags |= (0x80 >> i);
@@ -142,6 +245,7 @@ unsigned char *LZCompress(unsigned char *src, int srcSize, int *compressedSize,
 						dest[destPos++] = 0;
 				}
 
+				free(matches);
 				*compressedSize = destPos;
 				return dest;
 			}
@@ -3,6 +3,22 @@
 #ifndef LZ_H
 #define LZ_H
 
+#define LZ_WINDOW_SIZE 0x1000
+#define LZ_MAX_BLOCK_SIZE 18
+
+// Inputs are split into at most LZ_MAX_THREADS chunks of at least
+// LZ_MIN_CHUNK_SIZE bytes for the match search.
+#define LZ_MIN_CHUNK_SIZE 0x8000
+#define LZ_MAX_THREADS 8
+
+// Match size of positions the search hasn't reached.
+#define LZ_MATCH_UNKNOWN 0xFF
+
+struct LZMatch {
+	unsigned char size;
+	unsigned short distance;
+};
+
 unsigned char *LZDecompress(unsigned char *src, int srcSize, int *uncompressedSize);
 unsigned char *LZCompress(unsigned char *src, int srcSize, int *compressedSize, const int minDistance);
 
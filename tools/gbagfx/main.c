@@ -13,6 +13,8 @@
 #include "rl.h"
 #include "font.h"
 #include "huff.h"
+#include "atlas.h"
+#include "convert.h"
 
 struct CommandHandler
 {
@@ -76,19 +78,12 @@ void ConvertGbaToPng(char *inputPath, char *outputPath, struct GbaToPngOptions *
 
 void ConvertPngToGba(char *inputPath, char *outputPath, struct PngToGbaOptions *options)
 {
-    struct Image image;
-
-    image.bitDepth = options->bitDepth;
-    image.tilemap.data.affine = NULL; // initialize to NULL to avoid issues in FreeImage
+    int size;
+    unsigned char *buffer = EncodePngAsGba(inputPath, options, &size);
 
-    ReadPng(inputPath, &image);
-
-    if (options->isTiled)
-        WriteTileImage(outputPath, options->numTilesMode, options->numTiles, options->metatileWidth, options->metatileHeight, &image, !image.hasPalette);
-    else
-        WritePlainImage(outputPath, options->dataWidth, &image, !image.hasPalette);
+    WriteWholeFile(outputPath, buffer, size);
 
-    FreeImage(&image);
+    free(buffer);
 }
 
 void HandleGbaToPngCommand(char *inputPath, char *outputPath, int argc, char **argv)
@@ -201,89 +196,98 @@ void HandleGbaToPngCommand(char *inputPath, char *outputPath, int argc, char **a
     ConvertGbaToPng(inputPath, outputPath, &options);
 }
 
-void HandlePngToGbaCommand(char *inputPath, char *outputPath, int argc, char **argv)
+bool ParsePngToGbaOption(struct PngToGbaOptions *options, int argc, char **argv, int *i)
 {
-    char *outputFileExtension = GetFileExtensionAfterDot(outputPath);
-    struct PngToGbaOptions options;
-    options.numTilesMode = NUM_TILES_IGNORE;
-    options.numTiles = 0;
-    options.bitDepth = outputFileExtension[0] - '0';
-    options.metatileWidth = 1;
-    options.metatileHeight = 1;
-    options.tilemapFilePath = NULL;
-    options.isAffineMap = false;
-    options.isTiled = true;
-    options.dataWidth = 1;
+    char *option = argv[*i];
 
-    for (int i = 3; i < argc; i++)
+    if (strcmp(option, "-num_tiles") == 0)
     {
-        char *option = argv[i];
+        if (*i + 1 >= argc)
+            FATAL_ERROR("No number of tiles following \"-num_tiles\".\n");
 
-        if (strcmp(option, "-num_tiles") == 0)
-        {
-            if (i + 1 >= argc)
-                FATAL_ERROR("No number of tiles following \"-num_tiles\".\n");
+        (*i)++;
 
-            i++;
+        if (!ParseNumber(argv[*i], NULL, 10, &options->numTiles))
+            FATAL_ERROR("Failed to parse number of tiles.\n");
 
-            if (!ParseNumber(argv[i], NULL, 10, &options.numTiles))
-                FATAL_ERROR("Failed to parse number of tiles.\n");
+        if (options->numTiles < 1)
+            FATAL_ERROR("Number of tiles must be positive.\n");
+    }
+    else if (strcmp(option, "-Wnum_tiles") == 0) {
+        options->numTilesMode = NUM_TILES_WARN;
+    }
+    else if (strcmp(option, "-Werror=num_tiles") == 0) {
+        options->numTilesMode = NUM_TILES_ERROR;
+    }
+    else if (strcmp(option, "-mwidth") == 0)
+    {
+        if (*i + 1 >= argc)
+            FATAL_ERROR("No metatile width value following \"-mwidth\".\n");
 
-            if (options.numTiles < 1)
-                FATAL_ERROR("Number of tiles must be positive.\n");
-        }
-        else if (strcmp(option, "-Wnum_tiles") == 0) {
-            options.numTilesMode = NUM_TILES_WARN;
-        }
-        else if (strcmp(option, "-Werror=num_tiles") == 0) {
-            options.numTilesMode = NUM_TILES_ERROR;
-        }
-        else if (strcmp(option, "-mwidth") == 0)
-        {
-            if (i + 1 >= argc)
-                FATAL_ERROR("No metatile width value following \"-mwidth\".\n");
+        (*i)++;
 
-            i++;
+        if (!ParseNumber(argv[*i], NULL, 10, &options->metatileWidth))
+            FATAL_ERROR("Failed to parse metatile width.\n");
 
-            if (!ParseNumber(argv[i], NULL, 10, &options.metatileWidth))
-                FATAL_ERROR("Failed to parse metatile width.\n");
+        if (options->metatileWidth < 1)
+            FATAL_ERROR("metatile width must be positive.\n");
+    }
+    else if (strcmp(option, "-mheight") == 0)
+    {
+        if (*i + 1 >= argc)
+            FATAL_ERROR("No metatile height value following \"-mheight\".\n");
 
-            if (options.metatileWidth < 1)
-                FATAL_ERROR("metatile width must be positive.\n");
-        }
-        else if (strcmp(option, "-mheight") == 0)
-        {
-            if (i + 1 >= argc)
-                FATAL_ERROR("No metatile height value following \"-mheight\".\n");
+        (*i)++;
 
-            i++;
+        if (!ParseNumber(argv[*i], NULL, 10, &options->metatileHeight))
+            FATAL_ERROR("Failed to parse metatile height.\n");
 
-            if (!ParseNumber(argv[i], NULL, 10, &options.metatileHeight))
-                FATAL_ERROR("Failed to parse metatile height.\n");
+        if (options->metatileHeight < 1)
+            FATAL_ERROR("metatile height must be positive.\n");
+    }
+    else if (strcmp(option, "-tilemap") == 0)
+    {
+        if (*i + 1 >= argc)
+            FATAL_ERROR("No tilemap value following \"-tilemap\".\n");
 
-            if (options.metatileHeight < 1)
-                FATAL_ERROR("metatile height must be positive.\n");
-        }
-        else if (strcmp(option, "-plain") == 0)
-        {
-            options.isTiled = false;
-        }
-        else if (strcmp(option, "-data_width") == 0)
-        {
-            if (i + 1 >= argc)
-                FATAL_ERROR("No data width value following \"-data_width\".\n");
-            i++;
+        (*i)++;
 
-            if (!ParseNumber(argv[i], NULL, 10, &options.dataWidth))
-                FATAL_ERROR("Failed to parse data width.\n");
+        options->tilemapFilePath = argv[*i];
+    }
+    else if (strcmp(option, "-plain") == 0)
+    {
+        options->isTiled = false;
+    }
+    else if (strcmp(option, "-data_width") == 0)
+    {
+        if (*i + 1 >= argc)
+            FATAL_ERROR("No data width value following \"-data_width\".\n");
+        (*i)++;
 
-            if (options.dataWidth < 1)
-                FATAL_ERROR("Data width must be positive.\n");
-        }
-        else
-        {
-            FATAL_ERROR("Unrecognized option \"%s\".\n", option);
-        }
+        if (!ParseNumber(argv[*i], NULL, 10, &options->dataWidth))
+            FATAL_ERROR("Failed to parse data width.\n");
+
+        if (options->dataWidth < 1)
+            FATAL_ERROR("Data width must be positive.\n");
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+void HandlePngToGbaCommand(char *inputPath, char *outputPath, int argc, char **argv)
+{
+    char *outputFileExtension = GetFileExtensionAfterDot(outputPath);
+    struct PngToGbaOptions options;
+    InitPngToGbaOptions(&options, outputFileExtension);
+
+    for (int i = 3; i < argc; i++)
+    {
+        if (!ParsePngToGbaOption(&options, argc, argv, &i))
+            FATAL_ERROR("Unrecognized option \"%s\".\n", argv[i]);
     }
 
     ConvertPngToGba(inputPath, outputPath, &options);
@@ -409,53 +413,98 @@ void HandleFullwidthJapaneseFontToPngCommand(char *inputPath, char *outputPath,
     FreeImage(&image);
 }
 
-void HandlePngToFullwidthJapaneseFontCommand(char *inputPath, char *outputPath, int argc UNUSED, char **argv UNUSED)
+void HandlePngToFullwidthJapaneseFontCommand(char *inputPath, char *outputPath, int argc, char **argv)
 {
+    char *glyphListPath = NULL;
+    char *headerPath = NULL;
+
+    for (int i = 3; i < argc; i++)
+    {
+        char *option = argv[i];
+
+        if (strcmp(option, "-glyphs") == 0)
+        {
+            if (i + 1 >= argc)
+                FATAL_ERROR("No glyph list path following \"-glyphs\".\n");
+
+            i++;
+
+            glyphListPath = argv[i];
+        }
+        else if (strcmp(option, "-remap") == 0)
+        {
+            if (i + 1 >= argc)
+                FATAL_ERROR("No header file path following \"-remap\".\n");
+
+            i++;
+
+            headerPath = argv[i];
+        }
+        else
+        {
+            FATAL_ERROR("Unrecognized option \"%s\".\n", option);
+        }
+    }
+
+    if (headerPath != NULL && glyphListPath == NULL)
+        FATAL_ERROR("\"-remap\" needs a glyph list from \"-glyphs\".\n");
+
     struct Image image;
     image.tilemap.data.affine = NULL; // initialize to NULL to avoid issues in FreeImage
 
     image.bitDepth = 2;
 
     ReadPng(inputPath, &image);
+
+    if (glyphListPath != NULL)
+        SubsetFullwidthFont(&image, glyphListPath, headerPath);
+
     WriteFullwidthJapaneseFont(outputPath, &image);
 
     FreeImage(&image);
 }
 
-void HandleLZCompressCommand(char *inputPath, char *outputPath, int argc, char **argv)
+void HandleAtlasToGbaCommand(char *inputPath, char *outputPath, int argc, char **argv)
 {
-    int overflowSize = 0;
-    int minDistance = 2; // default, for compatibility with LZ77UnCompVram()
+    struct AtlasOptions options;
+    options.headerPath = NULL;
+    options.palettePath = NULL;
+    options.maxColorError = 0;
 
     for (int i = 3; i < argc; i++)
     {
         char *option = argv[i];
 
-        if (strcmp(option, "-overflow") == 0)
+        if (strcmp(option, "-header") == 0)
         {
             if (i + 1 >= argc)
-                FATAL_ERROR("No size following \"-overflow\".\n");
+                FATAL_ERROR("No header file path following \"-header\".\n");
 
             i++;
 
-            if (!ParseNumber(argv[i], NULL, 10, &overflowSize))
-                FATAL_ERROR("Failed to parse overflow size.\n");
+            options.headerPath = argv[i];
+        }
+        else if (strcmp(option, "-palette") == 0)
+        {
+            if (i + 1 >= argc)
+                FATAL_ERROR("No palette file path following \"-palette\".\n");
 
-            if (overflowSize < 1)
-                FATAL_ERROR("Overflow size must be positive.\n");
+            i++;
+
+            options.palettePath = argv[i];
         }
-        else if (strcmp(option, "-search") == 0)
+        else if (strcmp(option, "-max_color_error") == 0)
         {
             if (i + 1 >= argc)
-                FATAL_ERROR("No size following \"-search\".\n");
+                FATAL_ERROR("No color error following \"-max_color_error\".\n");
 
             i++;
 
-            if (!ParseNumber(argv[i], NULL, 10, &minDistance))
-                FATAL_ERROR("Failed to parse LZ min search distance.\n");
+            if (!ParseNumber(argv[i], NULL, 10, &options.maxColorError))
+                FATAL_ERROR("Failed to parse color error.\n");
 
-            if (minDistance < 1)
-                FATAL_ERROR("LZ min search distance must be positive.\n");
+            if (options.maxColorError < 0)
+                FATAL_ERROR("Color error must not be negative.\n");
         }
         else
         {
@@ -463,66 +512,140 @@ void HandleLZCompressCommand(char *inputPath, char *outputPath, int argc, char *
         }
     }
 
-    // The overflow option allows a quirk in some of Ruby/Sapphire's tilesets
-    // to be reproduced. It works by appending a number of zeros to the data
-    // before compressing it and then amending the LZ header's size field to
-    // reflect the expected size. This will cause an overflow when decompressing
-    // the data.
+    WriteSpriteAtlas(inputPath, outputPath, &options);
+}
 
-    int fileSize;
-    unsigned char *buffer = ReadWholeFileZeroPadded(inputPath, &fileSize, overflowSize);
+bool ParseCompressionOption(struct CompressionOptions *options, int argc, char **argv, int *i)
+{
+    char *option = argv[*i];
 
-    int compressedSize;
-    unsigned char *compressedData = LZCompress(buffer, fileSize + overflowSize, &compressedSize, minDistance);
+    if (options->type == COMPRESSION_LZ && strcmp(option, "-overflow") == 0)
+    {
+        if (*i + 1 >= argc)
+            FATAL_ERROR("No size following \"-overflow\".\n");
 
-    compressedData[1] = (unsigned char)fileSize;
-    compressedData[2] = (unsigned char)(fileSize >> 8);
-    compressedData[3] = (unsigned char)(fileSize >> 16);
+        (*i)++;
 
-    free(buffer);
+        if (!ParseNumber(argv[*i], NULL, 10, &options->overflowSize))
+            FATAL_ERROR("Failed to parse overflow size.\n");
+
+        if (options->overflowSize < 1)
+            FATAL_ERROR("Overflow size must be positive.\n");
+    }
+    else if (options->type == COMPRESSION_LZ && strcmp(option, "-search") == 0)
+    {
+        if (*i + 1 >= argc)
+            FATAL_ERROR("No size following \"-search\".\n");
+
+        (*i)++;
+
+        if (!ParseNumber(argv[*i], NULL, 10, &options->minDistance))
+            FATAL_ERROR("Failed to parse LZ min search distance.\n");
+
+        if (options->minDistance < 1)
+            FATAL_ERROR("LZ min search distance must be positive.\n");
+    }
+    else if (options->type == COMPRESSION_HUFF && strcmp(option, "-depth") == 0)
+    {
+        if (*i + 1 >= argc)
+            FATAL_ERROR("No size following \"-depth\".\n");
+
+        (*i)++;
+
+        if (!ParseNumber(argv[*i], NULL, 10, &options->bitDepth))
+            FATAL_ERROR("Failed to parse bit depth.\n");
+
+        if (options->bitDepth != 4 && options->bitDepth != 8)
+            FATAL_ERROR("GBA only supports bit depth of 4 or 8.\n");
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+void CompressAndWrite(char *outputPath, unsigned char *buffer, int size, struct CompressionOptions *options)
+{
+    int compressedSize;
+    unsigned char *compressedData = CompressBuffer(buffer, size, options, &compressedSize);
 
     WriteWholeFile(outputPath, compressedData, compressedSize);
 
     free(compressedData);
 }
 
-void HandleLZDecompressCommand(char *inputPath, char *outputPath, int argc UNUSED, char **argv UNUSED)
+void HandleCompressCommand(char *inputPath, char *outputPath, int argc, char **argv)
 {
-    int fileSize;
-    unsigned char *buffer = ReadWholeFile(inputPath, &fileSize);
+    struct CompressionOptions options;
+    InitCompressionOptions(&options, GetFileExtensionAfterDot(outputPath));
 
-    int uncompressedSize;
-    unsigned char *uncompressedData = LZDecompress(buffer, fileSize, &uncompressedSize);
+    for (int i = 3; i < argc; i++)
+    {
+        if (!ParseCompressionOption(&options, argc, argv, &i))
+            FATAL_ERROR("Unrecognized option \"%s\".\n", argv[i]);
+    }
 
-    free(buffer);
+    int fileSize;
+    unsigned char *buffer = ReadWholeFileZeroPadded(inputPath, &fileSize, options.overflowSize);
 
-    WriteWholeFile(outputPath, uncompressedData, uncompressedSize);
+    CompressAndWrite(outputPath, buffer, fileSize, &options);
 
-    free(uncompressedData);
+    free(buffer);
 }
 
-void HandleRLCompressCommand(char *inputPath, char *outputPath, int argc UNUSED, char **argv UNUSED)
+// Converts a png straight to compressed GBA data (e.g. "foo.png" -> "foo.4bpp.lz")
+// without going through an intermediate file. The intermediate file is only
+// written if "-write_intermediate" is passed.
+void HandlePngToCompressedGbaCommand(char *inputPath, char *outputPath, int argc, char **argv)
 {
-    int fileSize;
-    unsigned char *buffer = ReadWholeFile(inputPath, &fileSize);
+    char *intermediatePath = GetPathWithoutExtension(outputPath);
+    bool writeIntermediate = false;
 
-    int compressedSize;
-    unsigned char *compressedData = RLCompress(buffer, fileSize, &compressedSize);
+    struct PngToGbaOptions options;
+    InitPngToGbaOptions(&options, GetFileExtensionAfterDot(intermediatePath));
 
-    free(buffer);
+    struct CompressionOptions compressionOptions;
+    InitCompressionOptions(&compressionOptions, GetFileExtensionAfterDot(outputPath));
 
-    WriteWholeFile(outputPath, compressedData, compressedSize);
+    for (int i = 3; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-write_intermediate") == 0)
+            writeIntermediate = true;
+        else if (!ParsePngToGbaOption(&options, argc, argv, &i) && !ParseCompressionOption(&compressionOptions, argc, argv, &i))
+            FATAL_ERROR("Unrecognized option \"%s\".\n", argv[i]);
+    }
 
-    free(compressedData);
+    int size;
+    unsigned char *buffer = EncodePngAsGba(inputPath, &options, &size);
+
+    if (writeIntermediate)
+        WriteWholeFile(intermediatePath, buffer, size);
+
+    if (compressionOptions.overflowSize != 0)
+    {
+        buffer = realloc(buffer, size + compressionOptions.overflowSize);
+
+        if (buffer == NULL)
+            FATAL_ERROR("Failed to allocate memory for overflow padding.\n");
+
+        memset(buffer + size, 0, compressionOptions.overflowSize);
+    }
+
+    CompressAndWrite(outputPath, buffer, size, &compressionOptions);
+
+    free(buffer);
+    free(intermediatePath);
 }
 
-void HandleRLDecompressCommand(char *inputPath, char *outputPath, int argc UNUSED, char **argv UNUSED)
+void HandleLZDecompressCommand(char *inputPath, char *outputPath, int argc UNUSED, char **argv UNUSED)
 {
     int fileSize;
     unsigned char *buffer = ReadWholeFile(inputPath, &fileSize);
 
     int uncompressedSize;
-    unsigned char *uncompressedData = RLDecompress(buffer, fileSize, &uncompressedSize);
+    unsigned char *uncompressedData = LZDecompress(buffer, fileSize, &uncompressedSize);
 
     free(buffer);
 
@@ -531,44 +654,19 @@ void HandleRLDecompressCommand(char *inputPath, char *outputPath, int argc UNUSE
     free(uncompressedData);
 }
 
-void HandleHuffCompressCommand(char *inputPath, char *outputPath, int argc, char **argv)
+void HandleRLDecompressCommand(char *inputPath, char *outputPath, int argc UNUSED, char **argv UNUSED)
 {
     int fileSize;
-    int bitDepth = 4;
-
-    for (int i = 3; i < argc; i++)
-    {
-        char *option = argv[i];
-
-        if (strcmp(option, "-depth") == 0)
-        {
-            if (i + 1 >= argc)
-                FATAL_ERROR("No size following \"-depth\".\n");
-
-            i++;
-
-            if (!ParseNumber(argv[i], NULL, 10, &bitDepth))
-                FATAL_ERROR("Failed to parse bit depth.\n");
-
-            if (bitDepth != 4 && bitDepth != 8)
-                FATAL_ERROR("GBA only supports bit depth of 4 or 8.\n");
-        }
-        else
-        {
-            FATAL_ERROR("Unrecognized option \"%s\".\n", option);
-        }
-    }
-
     unsigned char *buffer = ReadWholeFile(inputPath, &fileSize);
 
-    int compressedSize;
-    unsigned char *compressedData = HuffCompress(buffer, fileSize, &compressedSize, bitDepth);
+    int uncompressedSize;
+    unsigned char *uncompressedData = RLDecompress(buffer, fileSize, &uncompressedSize);
 
     free(buffer);
 
-    WriteWholeFile(outputPath, compressedData, compressedSize);
+    WriteWholeFile(outputPath, uncompressedData, uncompressedSize);
 
-    free(compressedData);
+    free(uncompressedData);
 }
 
 void HandleHuffDecompressCommand(char *inputPath, char *outputPath, int argc UNUSED, char **argv UNUSED)
@@ -586,6 +684,13 @@ void HandleHuffDecompressCommand(char *inputPath, char *outputPath, int argc UNU
     free(uncompressedData);
 }
 
+bool IsCompressionFileExtension(char *extension)
+{
+    return strcmp(extension, "lz") == 0
+        || strcmp(extension, "rl") == 0
+        || strcmp(extension, "huff") == 0;
+}
+
 int main(int argc, char **argv)
 {
     char converted = 0;
@@ -611,15 +716,26 @@ int main(int argc, char **argv)
         { "png", "hwjpnfont", HandlePngToHalfwidthJapaneseFontCommand },
         { "fwjpnfont", "png", HandleFullwidthJapaneseFontToPngCommand },
         { "png", "fwjpnfont", HandlePngToFullwidthJapaneseFontCommand },
-        { NULL, "huff", HandleHuffCompressCommand },
-        { NULL, "lz", HandleLZCompressCommand },
+        { "atlas", "4bpp", HandleAtlasToGbaCommand },
+        { NULL, "huff", HandleCompressCommand },
+        { NULL, "lz", HandleCompressCommand },
         { "huff", NULL, HandleHuffDecompressCommand },
         { "lz", NULL, HandleLZDecompressCommand },
-        { NULL, "rl", HandleRLCompressCommand },
+        { NULL, "rl", HandleCompressCommand },
         { "rl", NULL, HandleRLDecompressCommand },
         { NULL, NULL, NULL }
     };
 
+    // Conversions that are followed by a compression step, e.g. "foo.png" -> "foo.4bpp.lz".
+    // These are matched against the extension in front of the compression extension.
+    struct CommandHandler chainedHandlers[] =
+    {
+        { "png", "1bpp", HandlePngToCompressedGbaCommand },
+        { "png", "4bpp", HandlePngToCompressedGbaCommand },
+        { "png", "8bpp", HandlePngToCompressedGbaCommand },
+        { NULL, NULL, NULL }
+    };
+
     char *inputPath = argv[1];
     char *outputPath = argv[2];
     char *inputFileExtension = GetFileExtensionAfterDot(inputPath);
@@ -628,6 +744,28 @@ int main(int argc, char **argv)
     if (inputFileExtension == NULL)
         FATAL_ERROR("Input file \"%s\" has no extension.\n", inputPath);
 
+    if (outputFileExtension != NULL && IsCompressionFileExtension(outputFileExtension))
+    {
+        char *intermediatePath = GetPathWithoutExtension(outputPath);
+        char *intermediateFileExtension = GetFileExtensionAfterDot(intermediatePath);
+
+        for (int i = 0; intermediateFileExtension != NULL && chainedHandlers[i].function != NULL; i++)
+        {
+            if (strcmp(chainedHandlers[i].inputFileExtension, inputFileExtension) == 0
+                && strcmp(chainedHandlers[i].outputFileExtension, intermediateFileExtension) == 0)
+            {
+                chainedHandlers[i].function(inputPath, outputPath, argc, argv);
+                converted = 1;
+                break;
+            }
+        }
+
+        free(intermediatePath);
+
+        if (converted)
+            return 0;
+    }
+
     if (outputFileExtension == NULL)
     {
         outputFileExtension = GetFileExtension(outputPath);
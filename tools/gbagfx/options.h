@@ -31,4 +31,17 @@ struct PngToGbaOptions {
     int dataWidth;
 };
 
+enum CompressionType {
+    COMPRESSION_LZ,
+    COMPRESSION_RL,
+    COMPRESSION_HUFF,
+};
+
+struct CompressionOptions {
+    enum CompressionType type;
+    int overflowSize;
+    int minDistance;
+    int bitDepth;
+};
+
 #endif // OPTIONS_H
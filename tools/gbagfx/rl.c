@@ -2,6 +2,8 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 #include "global.h"
 #include "rl.h"
 
@@ -61,6 +63,32 @@ fail:
     FATAL_ERROR("Fatal error while decompressing RL file.\n");
 }
 
+// Returns the end of the run of bytes equal to src[pos].
+// Long uniform regions (transparent sprite areas) are scanned eight bytes at a time.
+static int FindRunEnd(unsigned char *src, int pos, int srcSize)
+{
+    unsigned char data = src[pos];
+    uint64_t pattern = 0x0101010101010101ULL * data;
+    int end = pos + 1;
+
+    while (end + 8 <= srcSize)
+    {
+        uint64_t chunk;
+
+        memcpy(&chunk, &src[end], 8);
+
+        if (chunk != pattern)
+            break;
+
+        end += 8;
+    }
+
+    while (end < srcSize && src[end] == data)
+        end++;
+
+    return end;
+}
+
 unsigned char *RLCompress(unsigned char *src, int srcSize, int *compressedSize)
 {
     if (srcSize <= 0)
@@ -72,8 +100,11 @@ unsigned char *RLCompress(unsigned char *src, int srcSize, int *compressedSize)
     worstCaseDestSize = (worstCaseDestSize + 3) & ~3;
 
     unsigned char *dest = malloc(worstCaseDestSize);
+    int *runLength = malloc(srcSize * sizeof(int));
+    int *cost = malloc((srcSize + 1) * sizeof(int));
+    int *blockLength = malloc(srcSize * sizeof(int));
 
-    if (dest == NULL)
+    if (dest == NULL || runLength == NULL || cost == NULL || blockLength == NULL)
         goto fail;
 
     // header
@@ -82,68 +113,87 @@ unsigned char *RLCompress(unsigned char *src, int srcSize, int *compressedSize)
     dest[2] = (unsigned char)(srcSize >> 8);
     dest[3] = (unsigned char)(srcSize >> 16);
 
-    int srcPos = 0;
-    int destPos = 4;
-
-    for (;;)
+    for (int srcPos = 0; srcPos < srcSize;)
     {
-        bool compress = false;
-        int uncompressedStart = srcPos;
-        int uncompressedLength = 0;
-
-        while (srcPos < srcSize && uncompressedLength < (0x7F + 1))
-        {
-            compress = (srcPos + 2 < srcSize && src[srcPos] == src[srcPos + 1] && src[srcPos] == src[srcPos + 2]);
+        int end = FindRunEnd(src, srcPos, srcSize);
 
-            if (compress)
-                break;
+        for (; srcPos < end; srcPos++)
+            runLength[srcPos] = end - srcPos;
+    }
 
-            srcPos++;
-            uncompressedLength++;
-        }
+    // cost[i] is the smallest number of bytes that can encode src[i..srcSize).
+    // A positive blockLength is a literal block, a negative one is a run.
+    cost[srcSize] = 0;
 
-        if (uncompressedLength > 0)
-        {
-            dest[destPos++] = uncompressedLength - 1;
+    for (int srcPos = srcSize - 1; srcPos >= 0; srcPos--)
+    {
+        int bestCost = 1 + 1 + cost[srcPos + 1];
+        int bestLength = 1;
+        int maxLength = srcSize - srcPos;
 
-            for (int i = 0; i < uncompressedLength; i++)
-                dest[destPos++] = src[uncompressedStart + i];
-        }
+        if (maxLength > 0x7F + 1)
+            maxLength = 0x7F + 1;
 
-        if (compress)
+        for (int length = 2; length <= maxLength; length++)
         {
-            unsigned char data = src[srcPos];
-            int compressedLength = 0;
-
-            while (compressedLength < (0x7F + 3)
-                && srcPos + compressedLength < srcSize
-                && src[srcPos + compressedLength] == data)
+            if (1 + length + cost[srcPos + length] < bestCost)
             {
-                compressedLength++;
+                bestCost = 1 + length + cost[srcPos + length];
+                bestLength = length;
             }
+        }
 
-            dest[destPos++] = 0x80 | (compressedLength - 3);
-            dest[destPos++] = data;
+        maxLength = runLength[srcPos];
 
-            srcPos += compressedLength;
-        }
+        if (maxLength > 0x7F + 3)
+            maxLength = 0x7F + 3;
 
-        if (srcPos == srcSize)
+        for (int length = 3; length <= maxLength; length++)
         {
-            // Pad to multiple of 4 bytes.
-            int remainder = destPos % 4;
-
-            if (remainder != 0)
+            if (2 + cost[srcPos + length] < bestCost)
             {
-                for (int i = 0; i < 4 - remainder; i++)
-                    dest[destPos++] = 0;
+                bestCost = 2 + cost[srcPos + length];
+                bestLength = -length;
             }
+        }
 
-            *compressedSize = destPos;
-            return dest;
+        cost[srcPos] = bestCost;
+        blockLength[srcPos] = bestLength;
+    }
+
+    int srcPos = 0;
+    int destPos = 4;
+
+    while (srcPos < srcSize)
+    {
+        int length = blockLength[srcPos];
+
+        if (length < 0)
+        {
+            dest[destPos++] = 0x80 | (-length - 3);
+            dest[destPos++] = src[srcPos];
+            srcPos -= length;
+        }
+        else
+        {
+            dest[destPos++] = length - 1;
+
+            for (int i = 0; i < length; i++)
+                dest[destPos++] = src[srcPos++];
         }
     }
 
+    // Pad to multiple of 4 bytes.
+    while (destPos % 4 != 0)
+        dest[destPos++] = 0;
+
+    free(blockLength);
+    free(cost);
+    free(runLength);
+
+    *compressedSize = destPos;
+    return dest;
+
 fail:
     FATAL_ERROR("Fatal error while compressing RL file.\n");
 }
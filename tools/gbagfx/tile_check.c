@@ -0,0 +1,286 @@
+// Checks the tile kernels in gfx.c against the per-pixel conversion loops
+// they replaced. Every byte of every input buffer takes each of the 256
+// possible values across the passes, in both directions, at every bit depth,
+// with and without inverted colors, for several metatile layouts.
+
+#include "gfx.c"
+
+// The original conversion loops, kept as the reference.
+
+static void ConvertFromTiles1Bpp(unsigned char *src, unsigned char *dest, int numTiles, int metatilesWide, int metatileWidth, int metatileHeight, bool invertColors)
+{
+	int subTileX = 0;
+	int subTileY = 0;
+	int metatileX = 0;
+	int metatileY = 0;
+	int pitch = metatilesWide * metatileWidth;
+
+	for (int i = 0; i < numTiles; i++) {
+		for (int j = 0; j < 8; j++) {
+			int destY = (metatileY * metatileHeight + subTileY) * 8 + j;
+			int destX = metatileX * metatileWidth + subTileX;
+			unsigned char srcPixelOctet = *src++;
+			unsigned char *destPixelOctet = &dest[destY * pitch + destX];
+
+			for (int k = 0; k < 8; k++) {
+				*destPixelOctet <<= 1;
+				*destPixelOctet |= (srcPixelOctet & 1) ^ invertColors;
+				srcPixelOctet >>= 1;
+			}
+		}
+
+		AdvanceMetatilePosition(&subTileX, &subTileY, &metatileX, &metatileY, metatilesWide, metatileWidth, metatileHeight);
+	}
+}
+
+static void ConvertFromTiles4Bpp(unsigned char *src, unsigned char *dest, int numTiles, int metatilesWide, int metatileWidth, int metatileHeight, bool invertColors)
+{
+	int subTileX = 0;
+	int subTileY = 0;
+	int metatileX = 0;
+	int metatileY = 0;
+	int pitch = (metatilesWide * metatileWidth) * 4;
+
+	for (int i = 0; i < numTiles; i++) {
+		for (int j = 0; j < 8; j++) {
+			int destY = (metatileY * metatileHeight + subTileY) * 8 + j;
+
+			for (int k = 0; k < 4; k++) {
+				int destX = (metatileX * metatileWidth + subTileX) * 4 + k;
+				unsigned char srcPixelPair = *src++;
+				unsigned char leftPixel = srcPixelPair & 0xF;
+				unsigned char rightPixel = srcPixelPair >> 4;
+
+				if (invertColors) {
+					leftPixel = 15 - leftPixel;
+					rightPixel = 15 - rightPixel;
+				}
+
+				dest[destY * pitch + destX] = (leftPixel << 4) | rightPixel;
+			}
+		}
+
+		AdvanceMetatilePosition(&subTileX, &subTileY, &metatileX, &metatileY, metatilesWide, metatileWidth, metatileHeight);
+	}
+}
+
+static void ConvertFromTiles8Bpp(unsigned char *src, unsigned char *dest, int numTiles, int metatilesWide, int metatileWidth, int metatileHeight, bool invertColors)
+{
+	int subTileX = 0;
+	int subTileY = 0;
+	int metatileX = 0;
+	int metatileY = 0;
+	int pitch = (metatilesWide * metatileWidth) * 8;
+
+	for (int i = 0; i < numTiles; i++) {
+		for (int j = 0; j < 8; j++) {
+			int destY = (metatileY * metatileHeight + subTileY) * 8 + j;
+
+			for (int k = 0; k < 8; k++) {
+				int destX = (metatileX * metatileWidth + subTileX) * 8 + k;
+				unsigned char srcPixel = *src++;
+
+				if (invertColors)
+					srcPixel = 255 - srcPixel;
+
+				dest[destY * pitch + destX] = srcPixel;
+			}
+		}
+
+		AdvanceMetatilePosition(&subTileX, &subTileY, &metatileX, &metatileY, metatilesWide, metatileWidth, metatileHeight);
+	}
+}
+
+static void ConvertToTiles1Bpp(unsigned char *src, unsigned char *dest, int numTiles, int metatilesWide, int metatileWidth, int metatileHeight, bool invertColors)
+{
+	int subTileX = 0;
+	int subTileY = 0;
+	int metatileX = 0;
+	int metatileY = 0;
+	int pitch = metatilesWide * metatileWidth;
+
+	for (int i = 0; i < numTiles; i++) {
+		for (int j = 0; j < 8; j++) {
+			int srcY = (metatileY * metatileHeight + subTileY) * 8 + j;
+			int srcX = metatileX * metatileWidth + subTileX;
+			unsigned char srcPixelOctet = src[srcY * pitch + srcX];
+			unsigned char *destPixelOctet = dest++;
+
+			for (int k = 0; k < 8; k++) {
+				*destPixelOctet <<= 1;
+				*destPixelOctet |= (srcPixelOctet & 1) ^ invertColors;
+				srcPixelOctet >>= 1;
+			}
+		}
+
+		AdvanceMetatilePosition(&subTileX, &subTileY, &metatileX, &metatileY, metatilesWide, metatileWidth, metatileHeight);
+	}
+}
+
+static void ConvertToTiles4Bpp(unsigned char *src, unsigned char *dest, int numTiles, int metatilesWide, int metatileWidth, int metatileHeight, bool invertColors)
+{
+	int subTileX = 0;
+	int subTileY = 0;
+	int metatileX = 0;
+	int metatileY = 0;
+	int pitch = (metatilesWide * metatileWidth) * 4;
+
+	for (int i = 0; i < numTiles; i++) {
+		for (int j = 0; j < 8; j++) {
+			int srcY = (metatileY * metatileHeight + subTileY) * 8 + j;
+
+			for (int k = 0; k < 4; k++) {
+				int srcX = (metatileX * metatileWidth + subTileX) * 4 + k;
+				unsigned char srcPixelPair = src[srcY * pitch + srcX];
+				unsigned char leftPixel = srcPixelPair >> 4;
+				unsigned char rightPixel = srcPixelPair & 0xF;
+
+				if (invertColors) {
+					leftPixel = 15 - leftPixel;
+					rightPixel = 15 - rightPixel;
+				}
+
+				*dest++ = (rightPixel << 4) | leftPixel;
+			}
+		}
+
+		AdvanceMetatilePosition(&subTileX, &subTileY, &metatileX, &metatileY, metatilesWide, metatileWidth, metatileHeight);
+	}
+}
+
+static void ConvertToTiles8Bpp(unsigned char *src, unsigned char *dest, int numTiles, int metatilesWide, int metatileWidth, int metatileHeight, bool invertColors)
+{
+	int subTileX = 0;
+	int subTileY = 0;
+	int metatileX = 0;
+	int metatileY = 0;
+	int pitch = (metatilesWide * metatileWidth) * 8;
+
+	for (int i = 0; i < numTiles; i++) {
+		for (int j = 0; j < 8; j++) {
+			int srcY = (metatileY * metatileHeight + subTileY) * 8 + j;
+
+			for (int k = 0; k < 8; k++) {
+				int srcX = (metatileX * metatileWidth + subTileX) * 8 + k;
+				unsigned char srcPixel = src[srcY * pitch + srcX];
+
+				if (invertColors)
+					srcPixel = 255 - srcPixel;
+
+				*dest++ = srcPixel;
+			}
+		}
+
+		AdvanceMetatilePosition(&subTileX, &subTileY, &metatileX, &metatileY, metatilesWide, metatileWidth, metatileHeight);
+	}
+}
+
+typedef void (*ReferenceFunc)(unsigned char *, unsigned char *, int, int, int, int, bool);
+
+struct Layout {
+	int metatilesWide;
+	int metatileWidth;
+	int metatileHeight;
+	int metatilesHigh;
+};
+
+static const struct Layout sLayouts[] = {
+	{ 4, 1, 1, 4 },
+	{ 1, 1, 4, 2 },
+	{ 2, 2, 2, 3 },
+	{ 3, 4, 2, 2 },
+	{ 5, 3, 1, 3 },
+};
+
+static ReferenceFunc GetReferenceFunc(int bitDepth, bool toTiles)
+{
+	switch (bitDepth) {
+	case 1:
+		return toTiles ? ConvertToTiles1Bpp : ConvertFromTiles1Bpp;
+	case 4:
+		return toTiles ? ConvertToTiles4Bpp : ConvertFromTiles4Bpp;
+	default:
+		return toTiles ? ConvertToTiles8Bpp : ConvertFromTiles8Bpp;
+	}
+}
+
+// Returns the number of mismatching passes.
+static int CheckLayout(const struct Layout *layout, int bitDepth, bool toTiles, bool invertColors)
+{
+	int numTiles = layout->metatilesWide * layout->metatileWidth * layout->metatileHeight * layout->metatilesHigh;
+	int size = numTiles * bitDepth * 8;
+	unsigned char *input = malloc(size);
+	unsigned char *expected = malloc(size);
+	unsigned char *actual = malloc(size);
+	ReferenceFunc reference = GetReferenceFunc(bitDepth, toTiles);
+	int failures = 0;
+
+	if (input == NULL || expected == NULL || actual == NULL)
+		FATAL_ERROR("Failed to allocate memory for the check buffers.\n");
+
+	for (int pass = 0; pass < 256; pass++) {
+		for (int i = 0; i < size; i++)
+			input[i] = (i + pass) & 0xFF;
+
+		memset(expected, 0, size);
+		memset(actual, 0, size);
+
+		reference(input, expected, numTiles, layout->metatilesWide, layout->metatileWidth, layout->metatileHeight, invertColors);
+
+		if (toTiles)
+			ConvertTiles(input, actual, true, numTiles, layout->metatilesWide, layout->metatileWidth, layout->metatileHeight, bitDepth, invertColors);
+		else
+			ConvertTiles(actual, input, false, numTiles, layout->metatilesWide, layout->metatileWidth, layout->metatileHeight, bitDepth, invertColors);
+
+		if (memcmp(expected, actual, size) != 0) {
+			int i = 0;
+
+			while (expected[i] == actual[i])
+				i++;
+
+			fprintf(stderr, "%s %dbpp%s, %dx%d metatiles of %dx%d, pass %d: byte %d is 0x%02X, expected 0x%02X\n",
+				toTiles ? "ToTiles" : "FromTiles", bitDepth, invertColors ? " inverted" : "",
+				layout->metatilesWide, layout->metatilesHigh, layout->metatileWidth, layout->metatileHeight,
+				pass, i, actual[i], expected[i]);
+			failures++;
+		}
+	}
+
+	free(input);
+	free(expected);
+	free(actual);
+
+	return failures;
+}
+
+int main(void)
+{
+	static const int bitDepths[] = { 1, 4, 8 };
+	int failures = 0;
+	int cases = 0;
+
+	for (size_t i = 0; i < sizeof(sLayouts) / sizeof(sLayouts[0]); i++) {
+		for (size_t j = 0; j < sizeof(bitDepths) / sizeof(bitDepths[0]); j++) {
+			for (int toTiles = 0; toTiles < 2; toTiles++) {
+				for (int invertColors = 0; invertColors < 2; invertColors++) {
+					failures += CheckLayout(&sLayouts[i], bitDepths[j], toTiles, invertColors);
+					cases += 256;
+				}
+			}
+		}
+	}
+
+#ifdef __SSE2__
+	const char *kernels = "SSE2";
+#else
+	const char *kernels = "scalar";
+#endif
+
+	if (failures != 0) {
+		fprintf(stderr, "%d of %d %s tile conversion cases differ from the reference\n", failures, cases, kernels);
+		return 1;
+	}
+
+	printf("%d %s tile conversion cases match the reference\n", cases, kernels);
+	return 0;
+}
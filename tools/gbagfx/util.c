@@ -65,6 +65,22 @@ char *GetFileExtensionAfterDot(char *path)
 	return extension;
 }
 
+// Returns a newly allocated copy of the path with its last extension removed.
+char *GetPathWithoutExtension(char *path)
+{
+	char *extension = GetFileExtension(path);
+	size_t length = (extension == path) ? strlen(path) : (size_t)(extension - path);
+	char *result = malloc(length + 1);
+
+	if (result == NULL)
+		FATAL_ERROR("Failed to allocate memory for path.\n");
+
+	memcpy(result, path, length);
+	result[length] = 0;
+
+	return result;
+}
+
 unsigned char *ReadWholeFile(char *path, int *size)
 {
 	FILE *fp = fopen(path, "rb");
@@ -109,7 +125,7 @@ unsigned char *ReadWholeFileZeroPadded(char *path, int *size, int padAmount)
 
 	rewind(fp);
 
-	if (fread(buffer, *size, 1, fp) != 1)
+	if (*size > 0 && fread(buffer, *size, 1, fp) != 1)
 		FATAL_ERROR("Failed to read \"%s\".\n", path);
 
 	fclose(fp);
@@ -0,0 +1,169 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <ctime>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <memory>
+#include <sys/stat.h>
+#include "asset.h"
+#include "../gbagfx/convert.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#define MakeDirectory(path) _mkdir(path)
+#define GetProcessId() _getpid()
+#else
+#include <unistd.h>
+#define MakeDirectory(path) mkdir(path, 0777)
+#define GetProcessId() getpid()
+#endif
+
+// Bump this when gbagfx's default conversions change, so stale cache entries
+// aren't reused.
+static const char* const kAssetCacheVersion = "gbagfx-1";
+
+static bool GetModifiedTime(const std::string& path, std::time_t& time)
+{
+    struct stat st;
+
+    if (stat(path.c_str(), &st) != 0)
+        return false;
+
+    time = st.st_mtime;
+    return true;
+}
+
+static std::unique_ptr<unsigned char[]> ReadFile(const std::string& path, int& size)
+{
+    FILE* fp = std::fopen(path.c_str(), "rb");
+
+    if (fp == nullptr)
+        throw std::runtime_error("Failed to open \"" + path + "\" for reading.");
+
+    std::fseek(fp, 0, SEEK_END);
+
+    size = std::ftell(fp);
+
+    std::unique_ptr<unsigned char[]> buffer = std::unique_ptr<unsigned char[]>(new unsigned char[size + 1]);
+
+    std::rewind(fp);
+
+    if (size != 0 && std::fread(buffer.get(), size, 1, fp) != 1)
+        throw std::runtime_error("Failed to read \"" + path + "\".");
+
+    std::fclose(fp);
+
+    return buffer;
+}
+
+static void HashBytes(std::uint64_t& hash, const unsigned char* data, std::size_t length)
+{
+    for (std::size_t i = 0; i < length; i++)
+    {
+        hash ^= data[i];
+        hash *= 0x100000001B3ULL;
+    }
+}
+
+static void HashString(std::uint64_t& hash, const std::string& s)
+{
+    HashBytes(hash, reinterpret_cast<const unsigned char*>(s.c_str()), s.length() + 1);
+}
+
+// Everything after the first dot in the file name, e.g. "4bpp.lz".
+static std::string GetExtensions(const std::string& path)
+{
+    std::size_t slash = path.find_last_of("/\\");
+    std::size_t dot = path.find('.', slash == std::string::npos ? 0 : slash + 1);
+
+    return dot == std::string::npos ? std::string() : path.substr(dot + 1);
+}
+
+// Builds the cache path for an asset from the contents of its source. The
+// same source converted to the same format always lands in the same entry,
+// wherever the files live.
+static std::string GetCachePath(const std::string& path, const std::string& sourcePath)
+{
+    int sourceSize;
+    std::unique_ptr<unsigned char[]> source = ReadFile(sourcePath, sourceSize);
+    std::uint64_t hash = 0xCBF29CE484222325ULL;
+
+    HashString(hash, kAssetCacheVersion);
+    HashString(hash, GetExtensions(path));
+    HashString(hash, GetExtensions(sourcePath));
+    HashBytes(hash, source.get(), sourceSize);
+
+    char name[17];
+    std::snprintf(name, sizeof(name), "%016llX", static_cast<unsigned long long>(hash));
+
+    return std::string(kAssetCacheDir) + "/" + name + "." + GetExtensions(path);
+}
+
+static void WriteCacheEntry(const std::string& cachePath, unsigned char* data, int size)
+{
+    std::string dir(kAssetCacheDir);
+
+    for (std::size_t i = dir.find('/'); i != std::string::npos; i = dir.find('/', i + 1))
+        MakeDirectory(dir.substr(0, i).c_str());
+    MakeDirectory(dir.c_str());
+
+    // Write under a temporary name first, so parallel builds never read a
+    // partly written entry. The name is unique to this process and write,
+    // so two preprocs storing the same entry don't share a temporary file.
+    static unsigned tempCount = 0;
+    std::string tempPath = cachePath + ".tmp" + std::to_string(GetProcessId()) + "." + std::to_string(tempCount++);
+    FILE* fp = std::fopen(tempPath.c_str(), "wb");
+
+    if (fp == nullptr)
+        return;
+
+    bool ok = (size == 0 || std::fwrite(data, size, 1, fp) == 1);
+
+    std::fclose(fp);
+
+    if (!ok || std::rename(tempPath.c_str(), cachePath.c_str()) != 0)
+        std::remove(tempPath.c_str());
+}
+
+// Reads an INCBIN target. If it's an asset gbagfx builds from a png or pal
+// and it's missing or older than its source, it's converted in-process (or
+// taken from the cache) instead of needing a separate gbagfx run.
+// Returns nullptr for anything else, which should be read as-is.
+std::unique_ptr<unsigned char[]> ReadAsset(const std::string& path, int& size)
+{
+    std::string pathCopy(path);
+    char* sourcePathCStr = FindAssetSource(&pathCopy[0]);
+
+    if (sourcePathCStr == nullptr)
+        return nullptr;
+
+    std::string sourcePath(sourcePathCStr);
+    std::free(sourcePathCStr);
+
+    std::time_t sourceTime;
+    std::time_t targetTime;
+
+    if (!GetModifiedTime(sourcePath, sourceTime))
+        return nullptr;
+
+    if (GetModifiedTime(path, targetTime) && targetTime >= sourceTime)
+        return ReadFile(path, size);
+
+    std::string cachePath = GetCachePath(path, sourcePath);
+
+    if (GetModifiedTime(cachePath, targetTime))
+        return ReadFile(cachePath, size);
+
+    unsigned char* data = BuildAsset(&pathCopy[0], &size);
+
+    WriteCacheEntry(cachePath, data, size);
+
+    std::unique_ptr<unsigned char[]> buffer = std::unique_ptr<unsigned char[]>(new unsigned char[size + 1]);
+    std::copy(data, data + size, buffer.get());
+    std::free(data);
+
+    return buffer;
+}
@@ -0,0 +1,13 @@
+#ifndef ASSET_H
+#define ASSET_H
+
+#include <memory>
+#include <string>
+
+// Directory that converted INCBIN assets are cached in, keyed by a hash of
+// their source file.
+const char* const kAssetCacheDir = "build/assets";
+
+std::unique_ptr<unsigned char[]> ReadAsset(const std::string& path, int& size);
+
+#endif // ASSET_H
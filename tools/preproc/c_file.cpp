@@ -30,6 +30,7 @@
 #include "char_util.h"
 #include "utf8.h"
 #include "string_parser.h"
+#include "asset.h"
 
 CFile::CFile(const char * filenameCStr, bool isStdin)
 {
@@ -152,6 +153,76 @@ void CFile::Preproc()
     }
 }
 
+// Records the glyph codes used by every _() string in the file, without
+// producing any output. Strings in comments are skipped.
+void CFile::CollectGlyphs(std::set<std::uint16_t>& glyphs)
+{
+    char stringChar = 0;
+
+    while (m_pos < m_size)
+    {
+        char c = m_buffer[m_pos];
+
+        if (stringChar)
+        {
+            if (c == '\\')
+                m_pos++;
+            else if (c == stringChar)
+                stringChar = 0;
+            else if (c == '\n')
+                m_lineNum++;
+
+            m_pos++;
+        }
+        else if (c == '/' && (m_buffer[m_pos + 1] == '/' || m_buffer[m_pos + 1] == '*'))
+        {
+            SkipComment();
+        }
+        else
+        {
+            long oldPos = m_pos;
+
+            TryCollectGlyphs(glyphs);
+
+            // After a string macro, stop at its ')' so the next character is checked
+            // like any other, e.g. as the start of a comment holding an apostrophe.
+            if (m_pos != oldPos)
+                continue;
+
+            if (m_pos >= m_size)
+                break;
+
+            c = m_buffer[m_pos++];
+
+            if (c == '\n')
+                m_lineNum++;
+            else if (c == '"' || c == '\'')
+                stringChar = c;
+        }
+    }
+}
+
+void CFile::SkipComment()
+{
+    if (m_buffer[m_pos + 1] == '/')
+    {
+        while (m_pos < m_size && m_buffer[m_pos] != '\n')
+            m_pos++;
+        return;
+    }
+
+    m_pos += 2;
+
+    while (m_pos < m_size && !(m_buffer[m_pos] == '*' && m_buffer[m_pos + 1] == '/'))
+    {
+        if (m_buffer[m_pos] == '\n')
+            m_lineNum++;
+        m_pos++;
+    }
+
+    m_pos += 2;
+}
+
 bool CFile::ConsumeHorizontalWhitespace()
 {
     if (m_buffer[m_pos] == '\t' || m_buffer[m_pos] == ' ')
@@ -266,6 +337,77 @@ void CFile::TryConvertString()
         std::printf("0xFF }");
 }
 
+// Same as TryConvertString, but only records the glyphs the string uses.
+void CFile::TryCollectGlyphs(std::set<std::uint16_t>& glyphs)
+{
+    long oldPos = m_pos;
+    long oldLineNum = m_lineNum;
+
+    if (m_buffer[m_pos] != '_' || (m_pos > 0 && IsIdentifierChar(m_buffer[m_pos - 1])))
+        return;
+
+    m_pos++;
+
+    if (m_buffer[m_pos] == '_')
+        m_pos++;
+
+    while (IsAsciiWhitespace(m_buffer[m_pos]))
+    {
+        if (m_buffer[m_pos] == '\n')
+            m_lineNum++;
+        m_pos++;
+    }
+
+    if (m_buffer[m_pos] != '(')
+    {
+        m_pos = oldPos;
+        m_lineNum = oldLineNum;
+        return;
+    }
+
+    m_pos++;
+
+    while (1)
+    {
+        while (IsAsciiWhitespace(m_buffer[m_pos]))
+        {
+            if (m_buffer[m_pos] == '\n')
+                m_lineNum++;
+            m_pos++;
+        }
+
+        if (m_buffer[m_pos] == '"')
+        {
+            unsigned char s[kMaxStringLength];
+            int length;
+            StringParser stringParser(m_buffer, m_size);
+
+            stringParser.RecordGlyphs(&glyphs);
+
+            try
+            {
+                m_pos += stringParser.ParseString(m_pos, s, length);
+            }
+            catch (std::runtime_error& e)
+            {
+                RaiseError(e.what());
+            }
+        }
+        else if (m_buffer[m_pos] == ')')
+        {
+            m_pos++;
+            break;
+        }
+        else
+        {
+            // Not a string macro after all, e.g. a function named "_".
+            m_pos = oldPos;
+            m_lineNum = oldLineNum;
+            return;
+        }
+    }
+}
+
 bool CFile::CheckIdentifier(const std::string& ident)
 {
     unsigned int i;
@@ -392,7 +534,19 @@ void CFile::TryConvertIncbin()
         m_pos++;
 
         int fileSize;
-        std::unique_ptr<unsigned char[]> buffer = ReadWholeFile(path, fileSize);
+        std::unique_ptr<unsigned char[]> buffer;
+
+        try
+        {
+            buffer = ReadAsset(path, fileSize);
+        }
+        catch (std::runtime_error& e)
+        {
+            RaiseError(e.what());
+        }
+
+        if (buffer == nullptr)
+            buffer = ReadWholeFile(path, fileSize);
 
         if ((fileSize % size) != 0)
             RaiseError("Size %d doesn't evenly divide file size %d.\n", size, fileSize);
@@ -25,6 +25,7 @@
 #include <cstdint>
 #include <string>
 #include <memory>
+#include <set>
 #include "preproc.h"
 
 class CFile
@@ -35,6 +36,7 @@ public:
     CFile(const CFile&) = delete;
     ~CFile();
     void Preproc();
+    void CollectGlyphs(std::set<std::uint16_t>& glyphs);
 
 private:
     char* m_buffer;
@@ -47,7 +49,9 @@ private:
     bool ConsumeHorizontalWhitespace();
     bool ConsumeNewline();
     void SkipWhitespace();
+    void SkipComment();
     void TryConvertString();
+    void TryCollectGlyphs(std::set<std::uint16_t>& glyphs);
     std::unique_ptr<unsigned char[]> ReadWholeFile(const std::string& path, int& size);
     bool CheckIdentifier(const std::string& ident);
     void TryConvertIncbin();
@@ -56,6 +56,12 @@ inline bool IsAsciiPrintable(unsigned char c)
     return (c >= ' ' && c <= '~');
 }
 
+// Returns whether the character is a space, tab or line break.
+inline bool IsAsciiWhitespace(unsigned char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
 // Returns whether the character can start a C identifier or the identifier of a "{FOO}" constant in strings.
 inline bool IsIdentifierStartingChar(unsigned char c)
 {
@@ -68,4 +74,10 @@ inline bool IsIdentifierChar(unsigned char c)
     return IsAsciiAlphanum(c) || c == '_';
 }
 
+// Returns whether the code point is a CJK ideograph, the only characters the CJK font draws.
+inline bool IsCjkIdeograph(std::int32_t code)
+{
+    return code >= 0x4E00 && code <= 0x9FFF;
+}
+
 #endif // CHAR_UTIL_H
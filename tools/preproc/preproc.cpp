@@ -20,6 +20,7 @@
 
 #include <string>
 #include <stack>
+#include <set>
 #include "preproc.h"
 #include "asm_file.h"
 #include "c_file.h"
@@ -109,6 +110,29 @@ void PreprocCFile(const char * filename, bool isStdin)
     cFile.Preproc();
 }
 
+// Writes the glyph codes used by the strings of all the given C files, one
+// hex code per line, for gbagfx to cut the font down to.
+void CollectGlyphs(const char * outputPath, int numFiles, char **filenames)
+{
+    std::set<std::uint16_t> glyphs;
+
+    for (int i = 0; i < numFiles; i++)
+    {
+        CFile cFile(filenames[i], false);
+        cFile.CollectGlyphs(glyphs);
+    }
+
+    FILE *fp = std::fopen(outputPath, "w");
+
+    if (fp == NULL)
+        FATAL_ERROR("Failed to open \"%s\" for writing.\n", outputPath);
+
+    for (std::uint16_t glyph : glyphs)
+        std::fprintf(fp, "%04X\n", glyph);
+
+    std::fclose(fp);
+}
+
 char* GetFileExtension(char* filename)
 {
     char* extension = filename;
@@ -132,9 +156,17 @@ char* GetFileExtension(char* filename)
 
 int main(int argc, char **argv)
 {
+    if (argc >= 4 && std::string(argv[1]) == "-glyphs")
+    {
+        g_charmap = new Charmap(argv[2]);
+        CollectGlyphs(argv[3], argc - 4, argv + 4);
+        return 0;
+    }
+
     if (argc < 3 || argc > 4)
     {
-        std::fprintf(stderr, "Usage: %s SRC_FILE CHARMAP_FILE [-i]\nwhere -i denotes if input is from stdin\n", argv[0]);
+        std::fprintf(stderr, "Usage: %s SRC_FILE CHARMAP_FILE [-i]\nwhere -i denotes if input is from stdin\n"
+                             "       %s -glyphs CHARMAP_FILE OUTPUT_FILE SRC_FILE...\nto list the CJK glyphs the strings use\n", argv[0], argv[0]);
         return 1;
     }
 
@@ -90,6 +90,11 @@ std::string StringParser::ReadCharOrEscape()
             RaiseError("unknown character U+%X", code);
     }
 
+    // CJK glyphs map to two bytes (see charmap.txt). Other two-byte codes, like
+    // the one '_' maps to, aren't in the CJK font.
+    if (m_glyphs != nullptr && !isEscape && sequence.length() == 2 && IsCjkIdeograph(code))
+        m_glyphs->insert(((unsigned char)sequence[0] << 8) | (unsigned char)sequence[1]);
+
     return sequence;
 }
 
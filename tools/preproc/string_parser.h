@@ -23,13 +23,15 @@
 
 #include <cstdint>
 #include <string>
+#include <set>
 #include "preproc.h"
 
 class StringParser
 {
 public:
-    StringParser(char* buffer, long size) : m_buffer(buffer), m_size(size), m_pos(0) {}
+    StringParser(char* buffer, long size) : m_buffer(buffer), m_size(size), m_pos(0), m_glyphs(nullptr) {}
     int ParseString(long srcPos, unsigned char* dest, int &destLength);
+    void RecordGlyphs(std::set<std::uint16_t>* glyphs) { m_glyphs = glyphs; }
 
 private:
     struct Integer
@@ -41,6 +43,7 @@ private:
     char* m_buffer;
     long m_size;
     long m_pos;
+    std::set<std::uint16_t>* m_glyphs;
 
     Integer ReadInteger();
     Integer ReadDecimal();